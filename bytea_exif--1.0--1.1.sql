@@ -0,0 +1,161 @@
+/* contrib/bytea_exif/bytea_exif--1.0--1.1.sql */
+
+-- complain if script is sourced in psql, rather than via ALTER EXTENSION
+\echo Use "ALTER EXTENSION bytea_exif UPDATE TO '1.1'" to load this file. \quit
+
+CREATE OR REPLACE FUNCTION bytea_get_exif_datetime_original(data bytea)
+  RETURNS timestamptz
+  AS 'MODULE_PATHNAME'
+  LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+COMMENT ON FUNCTION bytea_get_exif_datetime_original
+IS 'Returns DateTimeOriginal EXIF value with OffsetTimeOriginal and SubSecTimeOriginal as timestamptz, local time without offset is interpreted as UTC';
+
+CREATE OR REPLACE FUNCTION bytea_get_exif_datetime_digitized(data bytea)
+  RETURNS timestamptz
+  AS 'MODULE_PATHNAME'
+  LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+COMMENT ON FUNCTION bytea_get_exif_datetime_digitized
+IS 'Returns DateTimeDigitized EXIF value with OffsetTimeDigitized and SubSecTimeDigitized as timestamptz, local time without offset is interpreted as UTC';
+
+CREATE OR REPLACE FUNCTION bytea_get_exif_jsonb(data bytea)
+  RETURNS jsonb
+  AS 'MODULE_PATHNAME'
+  LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+COMMENT ON FUNCTION bytea_get_exif_jsonb
+IS 'Returns jsonb with full set of EXIF tags and values, values not valid in the database encoding are skipped';
+
+CREATE OR REPLACE FUNCTION bytea_exif_summary(data bytea, OUT has_exif bool, OUT make text, OUT model text, OUT lens_model text, OUT datetime_original timestamptz, OUT gps_utc_timestamp timestamptz, OUT point text, OUT dest_point text, OUT user_comment text)
+  RETURNS record
+  AS 'MODULE_PATHNAME'
+  LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+COMMENT ON FUNCTION bytea_exif_summary
+IS 'Returns common metadata of an image from one EXIF data parse';
+
+CREATE OR REPLACE FUNCTION bytea_get_exif_makernote_jsonb(data bytea)
+  RETURNS jsonb
+  AS 'MODULE_PATHNAME'
+  LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+COMMENT ON FUNCTION bytea_get_exif_makernote_jsonb
+IS 'Returns interpreted MakerNote of EXIF data as jsonb';
+
+CREATE OR REPLACE FUNCTION bytea_exif_fingerprint(data bytea)
+  RETURNS bigint
+  AS 'MODULE_PATHNAME'
+  LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+COMMENT ON FUNCTION bytea_exif_fingerprint
+IS 'Returns 64 bit hash of EXIF TIFF data without reading of image data';
+
+CREATE OR REPLACE FUNCTION bytea_exif_summary_batch(images bytea[], OUT ord int, OUT has_exif bool, OUT make text, OUT model text, OUT lens_model text, OUT datetime_original timestamptz, OUT gps_utc_timestamp timestamptz, OUT point text, OUT dest_point text, OUT user_comment text)
+  RETURNS SETOF record
+  AS 'MODULE_PATHNAME'
+  LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+COMMENT ON FUNCTION bytea_exif_summary_batch
+IS 'Returns common metadata of all images of the array parsed by many threads';
+
+CREATE OR REPLACE FUNCTION bytea_exif_diagnose(data bytea, OUT tag text, OUT problem text, OUT message text, OUT detail text)
+  RETURNS SETOF record
+  AS 'MODULE_PATHNAME'
+  LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+COMMENT ON FUNCTION bytea_exif_diagnose
+IS 'Returns problems of EXIF date, time and user comment values of an image';
+
+CREATE OR REPLACE FUNCTION exif_tag_histogram_transfn(internal, bytea, text[])
+  RETURNS internal
+  AS 'MODULE_PATHNAME'
+  LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION exif_tag_histogram_combinefn(internal, internal)
+  RETURNS internal
+  AS 'MODULE_PATHNAME'
+  LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION exif_tag_histogram_serialfn(internal)
+  RETURNS bytea
+  AS 'MODULE_PATHNAME'
+  LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION exif_tag_histogram_deserialfn(bytea, internal)
+  RETURNS internal
+  AS 'MODULE_PATHNAME'
+  LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OR REPLACE FUNCTION exif_tag_histogram_finalfn(internal)
+  RETURNS jsonb
+  AS 'MODULE_PATHNAME'
+  LANGUAGE C IMMUTABLE PARALLEL SAFE;
+
+CREATE AGGREGATE exif_tag_histogram(data bytea, tags text[])
+(
+  SFUNC = exif_tag_histogram_transfn,
+  STYPE = internal,
+  FINALFUNC = exif_tag_histogram_finalfn,
+  COMBINEFUNC = exif_tag_histogram_combinefn,
+  SERIALFUNC = exif_tag_histogram_serialfn,
+  DESERIALFUNC = exif_tag_histogram_deserialfn,
+  PARALLEL = SAFE
+);
+
+COMMENT ON AGGREGATE exif_tag_histogram(bytea, text[])
+IS 'Returns jsonb as {tag : {value : count}} for pointed EXIF tags, every image is parsed once';
+
+CREATE OR REPLACE FUNCTION bytea_get_xmp(data bytea)
+  RETURNS xml
+  AS 'MODULE_PATHNAME'
+  LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+COMMENT ON FUNCTION bytea_get_xmp
+IS 'Returns XMP packet with extended XMP if any from JPEG APP1 segments, libexif is not used';
+
+CREATE OR REPLACE FUNCTION bytea_get_xmp_jsonb(data bytea)
+  RETURNS jsonb
+  AS 'MODULE_PATHNAME'
+  LANGUAGE C IMMUTABLE STRICT PARALLEL SAFE;
+
+COMMENT ON FUNCTION bytea_get_xmp_jsonb
+IS 'Returns flattened XMP properties as jsonb, repeated properties are arrays';
+
+CREATE OR REPLACE FUNCTION bytea_exif_fill_columns()
+  RETURNS trigger
+  AS 'MODULE_PATHNAME'
+  LANGUAGE C;
+
+COMMENT ON FUNCTION bytea_exif_fill_columns
+IS 'BEFORE INSERT OR UPDATE row trigger, arguments are image column and ''Tag=column'' pairs, EXIF data is parsed once for all columns';
+
+CREATE TABLE bytea_exif_queue (
+  relid regclass NOT NULL,
+  attname name NOT NULL,
+  pk text NOT NULL,
+  enqueued timestamptz NOT NULL DEFAULT now()
+);
+
+COMMENT ON TABLE bytea_exif_queue
+IS 'Queue of images for EXIF extraction by bytea_exif background workers: relation, bytea column and primary key value as text';
+
+CREATE TABLE bytea_exif_sidecar (
+  relid regclass NOT NULL,
+  pk text NOT NULL,
+  exif jsonb,
+  datetime_original timestamptz,
+  point text,
+  error text,
+  updated timestamptz NOT NULL DEFAULT now(),
+  PRIMARY KEY (relid, pk)
+);
+
+COMMENT ON TABLE bytea_exif_sidecar
+IS 'EXIF data extracted by bytea_exif background workers';
+
+COMMENT ON COLUMN bytea_exif_sidecar.error
+IS 'Error message if the image can not be processed, NULL after successful extraction';
+
+SELECT pg_catalog.pg_extension_config_dump('bytea_exif_queue', '');
+SELECT pg_catalog.pg_extension_config_dump('bytea_exif_sidecar', '');
@@ -13,12 +13,14 @@
 #include "postgres.h"
 #include "bytea_exif.h"
 
-#include <iconv.h>
-
+#include "access/htup_details.h"
 #include "fmgr.h"
+#include "funcapi.h"
 #include "mb/pg_wchar.h"
 #include "storage/ipc.h"
 #include "utils/builtins.h"
+#include "utils/datetime.h"
+#include "utils/jsonb.h"
 #include "utils/timestamp.h"
 #if PG_VERSION_NUM >= 160000
 	#include "varatt.h"
@@ -40,11 +42,16 @@ Datum bytea_has_exif(PG_FUNCTION_ARGS);
 Datum bytea_has_exif_ifd(PG_FUNCTION_ARGS);
 Datum bytea_get_exif_tag_value(PG_FUNCTION_ARGS);
 Datum bytea_get_exif_json(PG_FUNCTION_ARGS);
+Datum bytea_get_exif_jsonb(PG_FUNCTION_ARGS);
 Datum bytea_get_exif_point(PG_FUNCTION_ARGS);
 Datum bytea_get_exif_dest_point(PG_FUNCTION_ARGS);
 Datum bytea_get_exif_gps_utc_timestamp(PG_FUNCTION_ARGS);
 Datum bytea_get_exif_gps_local_timestamp(PG_FUNCTION_ARGS);
+Datum bytea_get_exif_datetime_original(PG_FUNCTION_ARGS);
+Datum bytea_get_exif_datetime_digitized(PG_FUNCTION_ARGS);
 Datum bytea_get_exif_user_comment(PG_FUNCTION_ARGS);
+Datum bytea_exif_summary(PG_FUNCTION_ARGS);
+Datum bytea_get_exif_makernote_jsonb(PG_FUNCTION_ARGS);
 static void bytea_exif_exit(int code, Datum arg);
 
 extern PGDLLEXPORT void _PG_init(void);
@@ -59,14 +66,17 @@ PG_FUNCTION_INFO_V1(bytea_has_exif);
 PG_FUNCTION_INFO_V1(bytea_has_exif_ifd);
 PG_FUNCTION_INFO_V1(bytea_get_exif_tag_value);
 PG_FUNCTION_INFO_V1(bytea_get_exif_json);
+PG_FUNCTION_INFO_V1(bytea_get_exif_jsonb);
 PG_FUNCTION_INFO_V1(bytea_get_exif_point);
 PG_FUNCTION_INFO_V1(bytea_get_exif_dest_point);
 PG_FUNCTION_INFO_V1(bytea_get_exif_gps_utc_timestamp);
 PG_FUNCTION_INFO_V1(bytea_get_exif_gps_local_timestamp);
+PG_FUNCTION_INFO_V1(bytea_get_exif_datetime_original);
+PG_FUNCTION_INFO_V1(bytea_get_exif_datetime_digitized);
 PG_FUNCTION_INFO_V1(bytea_get_exif_user_comment);
+PG_FUNCTION_INFO_V1(bytea_exif_summary);
+PG_FUNCTION_INFO_V1(bytea_get_exif_makernote_jsonb);
 
-static double
-exif_gps_extract_double (ExifByteOrder o, ExifEntry * e);
 static void
 bytea_exif_exit(int code, Datum arg);
 static int
@@ -74,11 +84,13 @@ Ifd_from_name (char* ifdname);
 char*
 escapeJson(const char* json);
 static NullableDatum
-get_exif_utc_timestamp(bytea * arg);
+get_exif_utc_timestamp(Datum arg);
+static NullableDatum
+get_exif_datetime(Datum arg, ExifTag tag_dt);
 
 /*
- * Library load-time initialization, sets on_proc_exit() callback for
- * backend shutdown.
+ * Library load-time initialization, defines GUC variables, registers
+ * background workers and sets on_proc_exit() callback for backend shutdown.
  */
 void
 _PG_init(void)
@@ -105,6 +117,9 @@ _PG_init(void)
 		magic_cookie = NULL;
 	}
 #endif
+	exif_worker_init();
+	exif_batch_init();
+	exif_diag_init();
 	on_proc_exit(&bytea_exif_exit, PointerGetDatum(NULL));
 }
 
@@ -137,19 +152,14 @@ bytea_exif_libexif_version(PG_FUNCTION_ARGS)
 Datum
 bytea_has_exif(PG_FUNCTION_ARGS)
 {
-	bytea		   *arg = PG_GETARG_BYTEA_PP(0);
-	unsigned		len = VARSIZE_ANY_EXHDR(arg);
-	unsigned char  *dat = (unsigned char*)VARDATA_ANY(arg);
-	ExifLoader	   *loader = NULL;
+	Datum			arg = PG_GETARG_DATUM(0);
+	unsigned		len = exif_datum_size(arg);
 	ExifData	   *edata = NULL;
 
 	if (len == 0) /* no data */
 		PG_RETURN_BOOL(false);
 
-	loader = exif_loader_new ();
-	exif_loader_write (loader, dat, len);
-	edata = exif_loader_get_data (loader);
-	exif_loader_unref (loader);
+	edata = exif_data_from_datum(arg);
 	if (!edata) /* no EXIF data structure */
 	{
 		PG_RETURN_BOOL(false);
@@ -190,13 +200,11 @@ Ifd_from_name (char* ifdname)
 Datum
 bytea_has_exif_ifd(PG_FUNCTION_ARGS)
 {
-	bytea		   *arg = PG_GETARG_BYTEA_PP(0);
+	Datum			arg = PG_GETARG_DATUM(0);
 	char		   *ifdname = text_to_cstring(PG_GETARG_TEXT_PP(1));
 	int				ifd = -1;
-	unsigned		len = VARSIZE_ANY_EXHDR(arg);
-	unsigned char  *dat = (unsigned char*)VARDATA_ANY(arg);
+	unsigned		len = exif_datum_size(arg);
 	bool			res = false;
-	ExifLoader	   *loader = NULL;
 	ExifData	   *edata = NULL;
 	ExifContent	   *content = NULL;
 
@@ -207,10 +215,7 @@ bytea_has_exif_ifd(PG_FUNCTION_ARGS)
 	if (ifd == -1) /* invalid text of EXIF directory name */
 		PG_RETURN_NULL();
 
-	loader = exif_loader_new ();
-	exif_loader_write (loader, dat, len);
-	edata = exif_loader_get_data (loader);
-	exif_loader_unref (loader);
+	edata = exif_data_from_datum(arg);
 	if (!edata) /* no EXIF data structure */
 	{
 		PG_RETURN_BOOL(false);
@@ -235,16 +240,13 @@ bytea_has_exif_ifd(PG_FUNCTION_ARGS)
 Datum
 bytea_get_exif_tag_value(PG_FUNCTION_ARGS)
 {
-	bytea		   *arg = PG_GETARG_BYTEA_PP(0);
+	Datum			arg = PG_GETARG_DATUM(0);
 	char		   *tagname = text_to_cstring(PG_GETARG_TEXT_PP(1));
-	unsigned		len = VARSIZE_ANY_EXHDR(arg);
-	unsigned char  *dat = (unsigned char*)VARDATA_ANY(arg);
-	ExifLoader	   *loader = NULL;
+	unsigned		len = exif_datum_size(arg);
 	ExifData	   *edata = NULL;
-	ExifContent	*content = NULL;
 	ExifTag			tag = exif_tag_from_name(tagname);
 	ExifEntry	   *ee = NULL;
-	char			buf0[4096];
+	char			buf0[EXIF_CORE_VALUE_LEN];
 
 	if (len == 0)
 	{
@@ -253,45 +255,20 @@ bytea_get_exif_tag_value(PG_FUNCTION_ARGS)
 
 	if (!tag) /* no data, incorrect tag */
 	{
-		ereport(WARNING,
-			(errcode(ERRCODE_WARNING),
-			 errmsg("Tag name is not correct"),
-			 errhint("Please read EXIF specification and search for \"%s\"", tagname)));
+		exif_report_tag_name(tagname);
 		PG_RETURN_NULL();
 	}
 
-	loader = exif_loader_new ();
-	exif_loader_write (loader, dat, len);
-	edata = exif_loader_get_data (loader);
-	exif_loader_unref (loader);
+	edata = exif_data_from_datum(arg);
 	if (edata == NULL) /* no EXIF data structure */
 	{
 		PG_RETURN_NULL();
 	}
 
-	for (unsigned j = 0; j < EXIF_IFD_COUNT; j++)
-	{
-		content = edata->ifd[j];
-		if (!content) /* no EXIF data */
-			continue;
-
-		for (unsigned int i = 0; i < content->count; i++)
-		{
-			ExifEntry	   *ee_loop = content->entries[i];
-			const char	   *tname = exif_tag_get_name_in_ifd(ee_loop->tag, j);
-
-			if (strcmp(tname, tagname) == 0)
-			{
-				ee = ee_loop;
-				break;
-			}
-		}
-		if (ee != NULL)
-			break;
-	} /* ifd */
-
+	ee = exif_core_entry_by_name(edata, tagname);
 	if (ee == NULL) /* no such tage name */
 	{
+		exif_data_free (edata);
 		PG_RETURN_NULL();
 	}
 
@@ -373,10 +350,8 @@ escapeJson(const char* json)
 Datum
 bytea_get_exif_json(PG_FUNCTION_ARGS)
 {
-	bytea		   *arg = PG_GETARG_BYTEA_PP(0);
-	unsigned		len = VARSIZE_ANY_EXHDR(arg);
-	unsigned char  *dat = (unsigned char*)VARDATA_ANY(arg);
-	ExifLoader	   *loader = NULL;
+	Datum			arg = PG_GETARG_DATUM(0);
+	unsigned		len = exif_datum_size(arg);
 	ExifData	   *edata = NULL;
 	ExifContent	   *content = NULL;
 	StringInfo		buf = makeStringInfo();
@@ -386,10 +361,7 @@ bytea_get_exif_json(PG_FUNCTION_ARGS)
 	if (len == 0) /* no data */
 		PG_RETURN_NULL();
 
-	loader = exif_loader_new ();
-	exif_loader_write (loader, dat, len);
-	edata = exif_loader_get_data (loader);
-	exif_loader_unref (loader);
+	edata = exif_data_from_datum(arg);
 	if (!edata) /* no EXIF data structure */
 	{
 		PG_RETURN_NULL();
@@ -429,160 +401,212 @@ bytea_get_exif_json(PG_FUNCTION_ARGS)
 	PG_RETURN_TEXT_P(cstring_to_text(buf->data));
 }
 
-static double
-exif_gps_extract_double (ExifByteOrder o, ExifEntry * e)
+static void
+exif_push_string(JsonbParseState **pstate, JsonbIteratorToken seq, const char *str)
 {
-	ExifRational v_rat;
-	double res = 0.0;
+	JsonbValue	v;
 
-	if (e == NULL || e->format != EXIF_FORMAT_RATIONAL)
-		return NAN;
+	v.type = jbvString;
+	v.val.string.val = (char *) str;
+	v.val.string.len = strlen(str);
+	pushJsonbValue(pstate, seq, &v);
+}
 
-	if (e->components > 0)
-	{
-		v_rat = exif_get_rational (e->data + 8 * 0, o);
-		res += (double) v_rat.numerator / (double) v_rat.denominator;
-	}
+/*
+ * bytea_get_exif_jsonb
+ * All of EXIF tags as jsonb {"Name" : "value"}, the same as
+ * bytea_get_exif_json, but jsonb is built from the values without parsing
+ * of JSON text, hence any control character of a value is escaped on output.
+ * Values which are not valid in the database encoding are skipped. For tags
+ * repeated in some EXIF directories the last value is kept like for jsonb
+ * cast of bytea_get_exif_json result.
+ */
+Datum
+bytea_get_exif_jsonb(PG_FUNCTION_ARGS)
+{
+	Datum			arg = PG_GETARG_DATUM(0);
+	unsigned		len = exif_datum_size(arg);
+	ExifData	   *edata = NULL;
+	JsonbParseState *pstate = NULL;
+	JsonbValue	   *res;
 
-	if (e->components > 1)
-	{
-		v_rat = exif_get_rational (e->data + 8 * 1, o);
-		res += (double) v_rat.numerator / (double) v_rat.denominator / 60.0;
-	}
+	if (len == 0) /* no data */
+		PG_RETURN_NULL();
+
+	edata = exif_data_from_datum(arg);
+	if (!edata) /* no EXIF data structure */
+		PG_RETURN_NULL();
 
-	if (e->components > 2)
+	pushJsonbValue(&pstate, WJB_BEGIN_OBJECT, NULL);
+	for (unsigned j = 0; j < EXIF_IFD_COUNT; j++)
 	{
-		v_rat = exif_get_rational (e->data + 8 * 2, o);
-		res += (double) v_rat.numerator / (double) v_rat.denominator / 3600.0;
-	}
+		ExifContent *content = edata->ifd[j];
 
-	return res;
+		if (!content) /* no EXIF data */
+			continue;
+
+		for (unsigned int i = 0; i < content->count; i++)
+		{
+			ExifEntry  *ee = content->entries[i];
+			const char *name = exif_tag_get_name_in_ifd(ee->tag, j);
+			char		v[2001];
+
+			memset(v, 0, sizeof(v));
+			exif_entry_get_value (ee, v, sizeof (v));
+			if (name == NULL || !pg_verifymbstr(v, strlen(v), true))
+				continue;
+			exif_push_string(&pstate, WJB_KEY, name);
+			exif_push_string(&pstate, WJB_VALUE, v);
+		}
+	} /* ifd */
+	res = pushJsonbValue(&pstate, WJB_END_OBJECT, NULL);
+	exif_data_free (edata);
+	PG_RETURN_POINTER(JsonbValueToJsonb(res));
 }
 
+/*
+ * bytea_get_exif_makernote_jsonb
+ * Interpreted MakerNote as jsonb {"Name" : "value"}. Other functions don't
+ * interpret MakerNote, this is done only here. Values of some MakerNote
+ * formats are binary, values not valid in the database encoding are skipped.
+ */
 Datum
-bytea_get_exif_point(PG_FUNCTION_ARGS)
+bytea_get_exif_makernote_jsonb(PG_FUNCTION_ARGS)
 {
-	bytea		   *arg = PG_GETARG_BYTEA_PP(0);
-	unsigned		len = VARSIZE_ANY_EXHDR(arg);
-	unsigned char  *dat = (unsigned char*)VARDATA_ANY(arg);
-	ExifLoader	   *loader = NULL;
+	Datum			arg = PG_GETARG_DATUM(0);
+	unsigned		len = exif_datum_size(arg);
 	ExifData	   *edata = NULL;
-	ExifContent	   *content = NULL;
-	StringInfo		buf = makeStringInfo();
+	ExifMnoteData  *md;
+	JsonbParseState *pstate = NULL;
+	JsonbValue	   *res;
+	unsigned int	n;
 
 	if (len == 0) /* no data */
 		PG_RETURN_NULL();
 
-	loader = exif_loader_new ();
-	exif_loader_write (loader, dat, len);
-	edata = exif_loader_get_data (loader);
-	exif_loader_unref (loader);
+	edata = exif_data_from_datum_makernote(arg);
 	if (!edata) /* no EXIF data structure */
-	{
 		PG_RETURN_NULL();
-	}
-	content = edata->ifd[EXIF_IFD_GPS];
-	if (!content) /* no EXIF data */
+
+	md = exif_data_get_mnote_data(edata);
+	if (md == NULL) /* no MakerNote or not known MakerNote format */
 	{
 		exif_data_free (edata);
 		PG_RETURN_NULL();
 	}
 
+	pushJsonbValue(&pstate, WJB_BEGIN_OBJECT, NULL);
+	n = exif_mnote_data_count(md);
+	for (unsigned int i = 0; i < n; i++)
 	{
-		ExifByteOrder		o = exif_data_get_byte_order (edata);
+		const char *name = exif_mnote_data_get_name(md, i);
+		char		v[2001];
 
-		ExifEntry		   *e_lat = exif_content_get_entry (content, EXIF_TAG_GPS_LATITUDE);
-		ExifEntry		   *e_lat_ref = exif_content_get_entry (content, EXIF_TAG_GPS_LATITUDE_REF);
-		ExifEntry		   *e_lon = exif_content_get_entry (content, EXIF_TAG_GPS_LONGITUDE);
-		ExifEntry		   *e_lon_ref = exif_content_get_entry (content, EXIF_TAG_GPS_LONGITUDE_REF);
-		ExifEntry		   *e_geo_datum = exif_content_get_entry (content, EXIF_TAG_GPS_MAP_DATUM);
-
-		if (e_lon == NULL || e_lat == NULL || e_lon_ref == NULL || e_lat_ref == NULL) /* no necessary geo data */
-		{
-			exif_data_free (edata);
-			PG_RETURN_NULL();
-		}
-		else
-		{
-			double		lat = exif_gps_extract_double(o, e_lat);
-			double		lon = exif_gps_extract_double(o, e_lon);
-			char		lat_ref = e_lat_ref->size ? e_lat_ref->data[0] : 0;
-			char		lon_ref = e_lon_ref->size ? e_lon_ref->data[0] : 0;
-			const char *srid = (e_geo_datum == NULL) ? "" : (strncmp("WGS-84", (const char *)(e_geo_datum->data), e_geo_datum->size) == 0) ? "SRID=4326;" : "";
-
-			if ( lat_ref == 'S')
-				lat = lat * -1.0;
-			if ( lon_ref == 'W')
-				lon = lon * -1.0;
-			appendStringInfo(buf, "%sPoint(%2.*f %2.*f)", srid, 14, lon, 14, lat);
-		}
+		if (name == NULL || exif_mnote_data_get_value(md, i, v, sizeof(v)) == NULL)
+			continue;
+		if (!pg_verifymbstr(name, strlen(name), true) || !pg_verifymbstr(v, strlen(v), true))
+			continue;
+		exif_push_string(&pstate, WJB_KEY, name);
+		exif_push_string(&pstate, WJB_VALUE, v);
 	}
-
+	res = pushJsonbValue(&pstate, WJB_END_OBJECT, NULL);
 	exif_data_free (edata);
-	PG_RETURN_TEXT_P(cstring_to_text(buf->data));
+	PG_RETURN_POINTER(JsonbValueToJsonb(res));
 }
 
 Datum
-bytea_get_exif_dest_point(PG_FUNCTION_ARGS)
+bytea_get_exif_point(PG_FUNCTION_ARGS)
 {
-	bytea		   *arg = PG_GETARG_BYTEA_PP(0);
-	unsigned		len = VARSIZE_ANY_EXHDR(arg);
-	unsigned char  *dat = (unsigned char*)VARDATA_ANY(arg);
-	ExifLoader	   *loader = NULL;
+	Datum			arg = PG_GETARG_DATUM(0);
+	unsigned		len = exif_datum_size(arg);
 	ExifData	   *edata = NULL;
-	ExifContent	   *content = NULL;
-	StringInfo		buf = makeStringInfo();
+	char			buf[128];
+	bool			found;
 
 	if (len == 0) /* no data */
 		PG_RETURN_NULL();
 
-	loader = exif_loader_new ();
-	exif_loader_write (loader, dat, len);
-	edata = exif_loader_get_data (loader);
-	exif_loader_unref (loader);
+	edata = exif_data_from_datum(arg);
 	if (!edata) /* no EXIF data structure */
 	{
 		PG_RETURN_NULL();
 	}
-	content = edata->ifd[EXIF_IFD_GPS];
-	if (!content) /* no EXIF data */
-	{
-		exif_data_free (edata);
+
+	found = exif_core_gps_point(edata, 0, buf, sizeof(buf)) != 0;
+	exif_data_free (edata);
+	if (!found) /* no necessary geo data */
 		PG_RETURN_NULL();
-	}
+	PG_RETURN_TEXT_P(cstring_to_text(buf));
+}
 
-	{
-		ExifByteOrder		o = exif_data_get_byte_order (edata);
+Datum
+bytea_get_exif_dest_point(PG_FUNCTION_ARGS)
+{
+	Datum			arg = PG_GETARG_DATUM(0);
+	unsigned		len = exif_datum_size(arg);
+	ExifData	   *edata = NULL;
+	char			buf[128];
+	bool			found;
 
-		ExifEntry		   *e_lat = exif_content_get_entry (content, EXIF_TAG_GPS_DEST_LATITUDE);
-		ExifEntry		   *e_lat_ref = exif_content_get_entry (content, EXIF_TAG_GPS_DEST_LATITUDE_REF);
-		ExifEntry		   *e_lon = exif_content_get_entry (content, EXIF_TAG_GPS_DEST_LONGITUDE);
-		ExifEntry		   *e_lon_ref = exif_content_get_entry (content, EXIF_TAG_GPS_DEST_LONGITUDE_REF);
-		ExifEntry		   *e_geo_datum = exif_content_get_entry (content, EXIF_TAG_GPS_MAP_DATUM);
+	if (len == 0) /* no data */
+		PG_RETURN_NULL();
 
-		if (e_lon == NULL || e_lat == NULL || e_lon_ref == NULL || e_lat_ref == NULL) /* no necessary geo data */
-		{
-			exif_data_free (edata);
-			PG_RETURN_NULL();
-		}
-		else
-		{
-			double		lat = exif_gps_extract_double(o, e_lat);
-			double		lon = exif_gps_extract_double(o, e_lon);
-			char		lat_ref = e_lat_ref->size ? e_lat_ref->data[0] : 0;
-			char		lon_ref = e_lon_ref->size ? e_lon_ref->data[0] : 0;
-			const char *srid = (e_geo_datum == NULL) ? "" : (strncmp("WGS-84", (const char *)(e_geo_datum->data), e_geo_datum->size) == 0) ? "SRID=4326;" : "";
-
-			if ( lat_ref == 'S')
-				lat = lat * -1.0;
-			if ( lon_ref == 'W')
-				lon = lon * -1.0;
-			appendStringInfo(buf, "%sPoint(%2.*f %2.*f)", srid, 14, lon, 14, lat);
-		}
+	edata = exif_data_from_datum(arg);
+	if (!edata) /* no EXIF data structure */
+	{
+		PG_RETURN_NULL();
 	}
 
+	found = exif_core_gps_point(edata, 1, buf, sizeof(buf)) != 0;
 	exif_data_free (edata);
-	PG_RETURN_TEXT_P(cstring_to_text(buf->data));
+	if (!found) /* no necessary geo data */
+		PG_RETURN_NULL();
+	PG_RETURN_TEXT_P(cstring_to_text(buf));
+}
+
+/*
+ * exif_tm_to_timestamptz
+ * Converts date and time fields of EXIF data to timestamptz by direct
+ * arithmetic, without fmgr calls. Returns false for out of range values.
+ */
+bool
+exif_tm_to_timestamptz(const ExifCoreDateTime *dt, TimestampTz *result)
+{
+	struct pg_tm	tm;
+	int				pg_tz = -dt->tz; /* PostgreSQL counts seconds west of UTC */
+
+	if (!exif_core_datetime_valid(dt))
+		return false;
+
+	memset(&tm, 0, sizeof(tm));
+	tm.tm_year = dt->year;
+	tm.tm_mon = dt->month;
+	tm.tm_mday = dt->day;
+	tm.tm_hour = dt->hour;
+	tm.tm_min = dt->minute;
+	tm.tm_sec = dt->second;
+	if (tm2timestamp(&tm, dt->usec, &pg_tz, result) != 0)
+		return false;
+	return IS_VALID_TIMESTAMP(*result);
+}
+
+/*
+ * exif_status_timestamptz
+ * Converts date and time found by the core to nullable timestamptz datum
+ * and reports problems.
+ */
+static NullableDatum
+exif_status_timestamptz(ExifCoreStatus status, const ExifCoreDateTime *dt, ExifCoreInfo *info, int64 len)
+{
+	TimestampTz		res_tstz;
+
+	if (status == EXIF_CORE_OK && !exif_tm_to_timestamptz(dt, &res_tstz))
+		status = EXIF_CORE_DATETIME_RANGE;
+	/* malformed time zone offset is reported with the value read as UTC */
+	exif_report_status(status, info, len);
+	if (status != EXIF_CORE_OK)
+		return (struct NullableDatum) {PointerGetDatum(NULL), true};
+	return (struct NullableDatum) {TimestampTzGetDatum(res_tstz), false};
 }
 
 /*
@@ -590,109 +614,31 @@ bytea_get_exif_dest_point(PG_FUNCTION_ARGS)
  * helper for getting local time timestamp and UTC timestamp from exif
  */
 static NullableDatum
-get_exif_utc_timestamp(bytea * arg)
+get_exif_utc_timestamp(Datum arg)
 {
-	unsigned		len = VARSIZE_ANY_EXHDR(arg);
-	unsigned char  *dat = (unsigned char*)VARDATA_ANY(arg);
-	ExifLoader	   *loader = NULL;
-	ExifData	   *edata = NULL;
-	ExifContent	   *content = NULL;
-	Datum			res_tstz;
+	unsigned			len = exif_datum_size(arg);
+	ExifData		   *edata = NULL;
+	ExifCoreDateTime	dt;
+	ExifCoreInfo		info;
+	ExifCoreStatus		status;
 
 	if (len == 0) /* no data */
 		return (struct NullableDatum) {PointerGetDatum(NULL), true};
 
-	loader = exif_loader_new ();
-	exif_loader_write (loader, dat, len);
-	edata = exif_loader_get_data (loader);
-	exif_loader_unref (loader);
+	edata = exif_data_from_datum(arg);
 	if (!edata) /* no EXIF data structure */
 	{
 		return (struct NullableDatum) {PointerGetDatum(NULL), true};
 	}
-	content = edata->ifd[EXIF_IFD_GPS];
-	if (!content) /* no EXIF data */
-	{
-		exif_data_free (edata);
-		return (struct NullableDatum) {PointerGetDatum(NULL), true};
-	}
-
-	{
-		ExifByteOrder		o = exif_data_get_byte_order (edata);
-		ExifEntry		   *e_ts = exif_content_get_entry (content, EXIF_TAG_GPS_TIME_STAMP);
-		ExifEntry		   *e_ds = exif_content_get_entry (content, EXIF_TAG_GPS_DATE_STAMP);
-
-		if (e_ts == NULL || e_ds == NULL) /* no necessary timestamp data */
-		{
-			exif_data_free (edata);
-			return (struct NullableDatum) {PointerGetDatum(NULL), true};
-		}
-		else if (e_ds->format != EXIF_FORMAT_ASCII || e_ds->size != 11)
-		{
-			ereport(WARNING,
-				(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
-				 errmsg("Invalid GPS date EXIF format"),
-				 errhint("EXIF code: %d, EXIF length: %d", e_ds->format, e_ds->size)));
-			exif_data_free (edata);
-			return (struct NullableDatum) {PointerGetDatum(NULL), true};
-		}
-		else if (e_ts->format != EXIF_FORMAT_RATIONAL)
-		{
-			ereport(WARNING,
-				(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
-				 errmsg("Invalid GPS time EXIF format"),
-				 errhint("EXIF code: %d", e_ts->format)));
-			exif_data_free (edata);
-			return (struct NullableDatum) {PointerGetDatum(NULL), true};
-		}
-		else
-		{
-			int				y, m = 0, d = 0;
-			char		   *date = palloc(e_ds->size);
-			char		  **dptr = NULL;
-			ExifRational	rh = exif_get_rational (e_ts->data, o);
-			ExifRational	rm = exif_get_rational (e_ts->data + exif_format_get_size (e_ts->format),  o);
-			ExifRational	rs = exif_get_rational (e_ts->data + 2 * exif_format_get_size (e_ts->format), o);
-			bool			valid_time = rh.denominator & rm.denominator & rs.denominator;
-
-			strncpy (date, (char *) e_ds->data, e_ds->size);
-			y = (int) strtol((char*)(date + 0 * sizeof(char)), dptr, 10);
-			m = (int) strtol((char*)(date + 5 * sizeof(char)), dptr, 10);
-			d = (int) strtol((char*)(date + 8 * sizeof(char)), dptr, 10);
-			pfree(date);
-
-			if ( !valid_time )
-			{
-				exif_data_free (edata);
-				ereport(WARNING,
-					(errcode(ERRCODE_DATETIME_VALUE_OUT_OF_RANGE),
-					 errmsg("Invalid GPS data or GPS time EXIF format")));
-				return (struct NullableDatum) {PointerGetDatum(NULL), true};
-			}
-			else
-			{
-				double sec = (double) rs.numerator / (double) rs.denominator;
-				Datum UTC_tz = DirectFunctionCall1(namein, CStringGetDatum ("UTC"));
-				res_tstz = DirectFunctionCall7(make_timestamptz,
-					Int32GetDatum(y),
-					Int32GetDatum(m),
-					Int32GetDatum(d),
-					Int32GetDatum(rh.numerator / rh.denominator),
-					Int32GetDatum(rm.numerator / rm.denominator),
-					Float8GetDatum(sec),
-					UTC_tz);
-			}
-		}
-	}
+	status = exif_core_gps_datetime(edata, &dt, &info);
 	exif_data_free (edata);
-	return (struct NullableDatum) {res_tstz, false};
+	return exif_status_timestamptz(status, &dt, &info, len);
 }
 
 Datum
 bytea_get_exif_gps_utc_timestamp(PG_FUNCTION_ARGS)
 {
-	bytea		   *arg = PG_GETARG_BYTEA_PP(0);
-	NullableDatum	res = get_exif_utc_timestamp(arg);
+	NullableDatum	res = get_exif_utc_timestamp(PG_GETARG_DATUM(0));
 	if (res.isnull == true)
 		PG_RETURN_NULL();
 	else
@@ -706,180 +652,200 @@ bytea_get_exif_gps_utc_timestamp(PG_FUNCTION_ARGS)
 Datum
 bytea_get_exif_gps_local_timestamp(PG_FUNCTION_ARGS)
 {
-	bytea		   *arg = PG_GETARG_BYTEA_PP(0);
-	NullableDatum	res = get_exif_utc_timestamp(arg);
+	NullableDatum	res = get_exif_utc_timestamp(PG_GETARG_DATUM(0));
 	if (res.isnull == true)
 		PG_RETURN_NULL();
 	else
 		PG_RETURN_DATUM(res.value);
 }
 
-Datum
-bytea_get_exif_user_comment(PG_FUNCTION_ARGS)
+/*
+ * exif_data_datetime
+ * Converts DateTime, DateTimeOriginal or DateTimeDigitized EXIF value to
+ * timestamp, see exif_core_datetime. Local time without offset tag or
+ * with use_offset = false is interpreted as UTC time. Returns false if there
+ * is no correct value.
+ */
+bool
+exif_data_datetime(ExifData *edata, ExifTag tag_dt, bool use_offset, TimestampTz *result)
 {
-	bytea		   *arg = PG_GETARG_BYTEA_PP(0);
-	unsigned		len = VARSIZE_ANY_EXHDR(arg);
-	unsigned char  *dat = (unsigned char*)VARDATA_ANY(arg);
-	ExifLoader	   *loader = NULL;
-	ExifData	   *edata = NULL;
-	ExifContent	   *content = NULL;
-	ExifEntry	   *e = NULL;
-	bool			uc_ascii = false;
-	bool			uc_unicode = false;
-	bool			uc_jis = false;
-	bool			uc_undef = false;
-	bool			uc_encoding_ok = false;
-	char		   *user_comment_encoding = "UTF-16"; /* very often */
-	char		   *user_comment_exif = NULL;
-	char		   *user_comment_utf8 = "";
-	char		   *user_comment_pg = "";
-	int				len_uc = 0;
-#define UC_ENCODING_FIELD_SIZE 8
+	ExifCoreDateTime	dt;
+	ExifCoreInfo		info;
+	ExifCoreStatus		status = exif_core_datetime(edata, tag_dt, use_offset, &dt, &info);
+	NullableDatum		res = exif_status_timestamptz(status, &dt, &info, 0);
+
+	if (res.isnull)
+		return false;
+	*result = DatumGetTimestampTz(res.value);
+	return true;
+}
+
+/*
+ * get_exif_datetime:
+ * helper for DateTimeOriginal and DateTimeDigitized timestamptz functions
+ */
+static NullableDatum
+get_exif_datetime(Datum arg, ExifTag tag_dt)
+{
+	unsigned			len = exif_datum_size(arg);
+	ExifData		   *edata = NULL;
+	ExifCoreDateTime	dt;
+	ExifCoreInfo		info;
+	ExifCoreStatus		status;
 
 	if (len == 0) /* no data */
-		PG_RETURN_NULL();
+		return (struct NullableDatum) {PointerGetDatum(NULL), true};
 
-	loader = exif_loader_new ();
-	exif_loader_write (loader, dat, len);
-	edata = exif_loader_get_data (loader);
-	exif_loader_unref (loader);
+	edata = exif_data_from_datum(arg);
 	if (!edata) /* no EXIF data structure */
-	{
+		return (struct NullableDatum) {PointerGetDatum(NULL), true};
+
+	status = exif_core_datetime(edata, tag_dt, true, &dt, &info);
+	exif_data_free (edata);
+	return exif_status_timestamptz(status, &dt, &info, len);
+}
+
+Datum
+bytea_get_exif_datetime_original(PG_FUNCTION_ARGS)
+{
+	NullableDatum	res = get_exif_datetime(PG_GETARG_DATUM(0),
+											EXIF_TAG_DATE_TIME_ORIGINAL);
+	if (res.isnull == true)
 		PG_RETURN_NULL();
-	}
-	content = edata->ifd[EXIF_IFD_EXIF];
-	if (!content) /* no EXIF data */
-	{
-		exif_data_free (edata);
+	else
+		PG_RETURN_DATUM(res.value);
+}
+
+Datum
+bytea_get_exif_datetime_digitized(PG_FUNCTION_ARGS)
+{
+	NullableDatum	res = get_exif_datetime(PG_GETARG_DATUM(0),
+											EXIF_TAG_DATE_TIME_DIGITIZED);
+	if (res.isnull == true)
 		PG_RETURN_NULL();
-	}
+	else
+		PG_RETURN_DATUM(res.value);
+}
 
-	e = exif_content_get_entry (content, EXIF_TAG_USER_COMMENT);
+/*
+ * exif_user_comment_text
+ * Converts UserComment decoded by the core from UTF-8 to database encoding
+ * and reports problems. Frees utf8.
+ */
+static text *
+exif_user_comment_text(ExifCoreStatus status, char *utf8, ExifCoreInfo *info, int64 len)
+{
+	char	   *user_comment_pg;
+	text	   *res;
 
-	if (e == NULL) /* no necessary data */
-	{
-		exif_data_free (edata);
-		PG_RETURN_NULL();
-	}
+	exif_report_status(status, info, len);
+	if (status != EXIF_CORE_OK)
+		return NULL;
 
-	/*
-	 * The EXIF specification says UNDEFINED, but some
-	 * manufacturers don't care and use ASCII.
-	 */
-	if (e->format != EXIF_FORMAT_UNDEFINED && e->format != EXIF_FORMAT_ASCII )
-	{
-		ereport(WARNING,
-			(errcode(ERRCODE_WRONG_OBJECT_TYPE),
-			 errmsg("Invalid user comment EXIF format"),
-			 errdetail("Exif code: %d, normal is %d; bytea data length is %d bytes", e->format, EXIF_FORMAT_UNDEFINED, len)));
-		exif_data_free (edata);
+	user_comment_pg = (char *) pg_do_encoding_conversion(
+		(unsigned char *) utf8,
+		strlen(utf8),
+		PG_UTF8,
+		GetDatabaseEncoding());
+	res = cstring_to_text(user_comment_pg);
+	free(utf8);
+	return res;
+}
+
+Datum
+bytea_get_exif_user_comment(PG_FUNCTION_ARGS)
+{
+	Datum			arg = PG_GETARG_DATUM(0);
+	unsigned		len = exif_datum_size(arg);
+	ExifData	   *edata = NULL;
+	ExifCoreInfo	info;
+	ExifCoreStatus	status;
+	char		   *utf8 = NULL;
+	text		   *res;
+
+	if (len == 0) /* no data */
 		PG_RETURN_NULL();
-	}
 
-	if (e->format == EXIF_FORMAT_ASCII )
+	edata = exif_data_from_datum(arg);
+	if (!edata) /* no EXIF data structure */
 	{
-		ereport(WARNING,
-				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
-				 errmsg("EXIF user comment have EXIF_ACSII format"),
-				 errhint("Should be marked as EXIF undefined data; bytea data length is %d bytes", len)));
+		PG_RETURN_NULL();
 	}
 
-	if (e->size <= UC_ENCODING_FIELD_SIZE)
-	{
-		ereport(WARNING,
-			(errcode(ERRCODE_WRONG_OBJECT_TYPE),
-			 errmsg("No EXIF user comment text data"),
-			 errhint("Actual field length: %d, minimal is %d; bytea data length is %d bytes", e->size, UC_ENCODING_FIELD_SIZE, len)));
-		exif_data_free (edata);
+	status = exif_core_user_comment(edata, &utf8, &info);
+	exif_data_free (edata);
+	res = exif_user_comment_text(status, utf8, &info, len);
+	if (res == NULL)
 		PG_RETURN_NULL();
-	}
+	PG_RETURN_TEXT_P(res);
+}
 
-	uc_ascii = 0 == memcmp (e->data, "ASCII\0\0\0"  , UC_ENCODING_FIELD_SIZE);
-	uc_unicode = 0 == memcmp (e->data, "UNICODE\0"	, UC_ENCODING_FIELD_SIZE);
-	uc_jis = 0 == memcmp (e->data, "JIS\0\0\0\0\0", UC_ENCODING_FIELD_SIZE);
-	uc_undef = 0 == memcmp (e->data, "\0\0\0\0\0\0\0\0", UC_ENCODING_FIELD_SIZE);
-	uc_encoding_ok = uc_ascii || uc_unicode || uc_jis || uc_undef;
+/*
+ * exif_summary_values
+ * Forms EXIF_SUMMARY_NATTS values of bytea_exif_summary result from common
+ * metadata extracted by the core and reports problems. Strings of the
+ * summary are freed.
+ */
+void
+exif_summary_values(ExifCoreSummary *s, int64 len, Datum *values, bool *nulls)
+{
+	NullableDatum	ts;
+	text		   *uc;
+	char		   *strs[EXIF_SUMMARY_NATTS] = {NULL, s->make, s->model, s->lens_model,
+												NULL, NULL, s->point, s->dest_point, NULL};
 
-	if (uc_encoding_ok == false)
+	memset(nulls, false, sizeof(bool) * EXIF_SUMMARY_NATTS);
+	values[0] = BoolGetDatum(s->has_exif != 0);
+	for (int i = 1; i < EXIF_SUMMARY_NATTS; i++)
 	{
-		ereport(WARNING,
-			(errcode(ERRCODE_WRONG_OBJECT_TYPE),
-			 errmsg("Invalid encoding for user comment EXIF data"),
-			 errdetail("Encoding mark %.*s; bytea data length is %d bytes", UC_ENCODING_FIELD_SIZE, e->data, len)));
-		exif_data_free (edata);
-		PG_RETURN_NULL();
+		nulls[i] = strs[i] == NULL;
+		if (strs[i] != NULL)
+			values[i] = PointerGetDatum(cstring_to_text(strs[i]));
 	}
 
-	len_uc = e->size - UC_ENCODING_FIELD_SIZE;
-	/*
-	 * Note that, according to the specification (V2.1, p 40),
-	 * the user comment field does not have to be
-	 * NULL terminated.
-	 */
-	user_comment_exif = palloc(len_uc + 1);
-	memcpy(user_comment_exif, (char *) (e->data + UC_ENCODING_FIELD_SIZE), len_uc);
-	user_comment_exif[len_uc] = '\0';
-
-	if (uc_ascii || uc_undef)
-		user_comment_utf8 = user_comment_exif;
-	else if (uc_unicode || uc_jis)
-	{
-		char *input_ptr = user_comment_exif;
-		size_t input_bytes = len_uc;
-		size_t output_bytes = input_bytes * 2; /* maximum to UTF-8*/
-		char *output = palloc(output_bytes);
-		char *output_ptr = output;
-		size_t result = 0;
-		iconv_t conv_desc = NULL;
-
-		if (output == NULL)
-		{
-			ereport(WARNING,
-				(errcode(ERRCODE_OUT_OF_MEMORY),
-				 errmsg("Iconv memory fail"),
-				 errhint("bytea data length is %d bytes", len)));
-			exif_data_free (edata);
-			PG_RETURN_NULL();
-		}
+	ts = exif_status_timestamptz(s->datetime_status, &s->datetime_original, &s->datetime_info, len);
+	values[4] = ts.value;
+	nulls[4] = ts.isnull;
+	ts = exif_status_timestamptz(s->gps_status, &s->gps_utc, &s->gps_info, len);
+	values[5] = ts.value;
+	nulls[5] = ts.isnull;
 
-		user_comment_encoding = uc_unicode ? "UTF-16" : "JIS";
+	uc = exif_user_comment_text(s->uc_status, s->user_comment, &s->uc_info, len);
+	s->user_comment = NULL;
+	values[8] = PointerGetDatum(uc);
+	nulls[8] = uc == NULL;
 
-		conv_desc = iconv_open ("UTF-8", user_comment_encoding);
-		if ( conv_desc == NULL )
-		{
-			if (errno == EINVAL)
-				ereport(ERROR,
-					(errcode(ERRCODE_UNDEFINED_FUNCTION),
-					 errmsg("default conversion function for encoding \"%s\" to \"%s\" does not exist in iconv",
-							user_comment_encoding,
-							"UTF-8")));
-			else
-				ereport(ERROR,
-					(errcode(ERRCODE_UNDEFINED_FUNCTION),
-					 errmsg("Iconv initialization error")));
-		}
+	exif_core_summary_free(s);
+}
 
-		result = iconv(conv_desc, &input_ptr, &input_bytes, &output_ptr, &output_bytes);
-		if (result == (size_t)-1)
-		{
-			ereport(WARNING,
-				(errcode(ERRCODE_UNDEFINED_FUNCTION),
-				 errmsg("Iconv fail"),
-				 errhint("Encoding mark %.*s; bytea data length is %d bytes", UC_ENCODING_FIELD_SIZE, e->data, len)));
-			exif_data_free (edata);
-			PG_RETURN_NULL();
-		}
-		*output_ptr = '\0';
-		user_comment_utf8 = output;
-	}
+/*
+ * bytea_exif_summary
+ * Common metadata of an image from one EXIF data parse.
+ */
+Datum
+bytea_exif_summary(PG_FUNCTION_ARGS)
+{
+	Datum			arg = PG_GETARG_DATUM(0);
+	unsigned		len = exif_datum_size(arg);
+	ExifData	   *edata = NULL;
+	ExifCoreSummary	s;
+	TupleDesc		tupdesc;
+	Datum			values[EXIF_SUMMARY_NATTS];
+	bool			nulls[EXIF_SUMMARY_NATTS];
 
-	user_comment_pg = (char *) pg_do_encoding_conversion(
-		(unsigned char *) user_comment_utf8,
-		strlen(user_comment_utf8),
-		PG_UTF8,
-		GetDatabaseEncoding());
-	exif_data_free (edata);
-	PG_RETURN_TEXT_P(cstring_to_text(user_comment_pg));
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("function returning record called in context that cannot accept type record")));
+	tupdesc = BlessTupleDesc(tupdesc);
+
+	if (len > 0)
+		edata = exif_data_from_datum(arg);
+	exif_core_summary(edata, &s);
+	if (edata != NULL)
+		exif_data_free (edata);
+	exif_summary_values(&s, len, values, nulls);
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
 }
 
 Datum
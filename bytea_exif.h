@@ -21,6 +21,11 @@
 #include <libexif/exif-data-type.h>
 #include <libexif/exif-tag.h>
 #include <libexif/exif-format.h>
+#include <libexif/exif-mnote-data.h>
+
+#include "datatype/timestamp.h"
+
+#include "bytea_exif_core.h"
 
 #include <math.h>
 #include <string.h>
@@ -37,4 +42,57 @@ typedef struct NullableDatum
 } NullableDatum;
 #endif
 
+/* Number of bytea_exif_summary columns */
+#define EXIF_SUMMARY_NATTS	9
+
+/* Size of detoasted slice window for reading of external bytea values */
+#define EXIF_READER_WINDOW	(64 * 1024)
+
+/*
+ * Reader for a possibly toasted bytea value. Only requested slices of
+ * external or compressed values are detoasted.
+ */
+typedef struct ExifByteaReader
+{
+	Datum				datum;		/* original value */
+	const unsigned char *data;		/* data of not toasted value or NULL */
+	int64				size;		/* data size without varlena header */
+	bytea			   *win;		/* last detoasted slice */
+	int64				win_off;
+	int32				win_len;
+	ExifJpegSegments	segments;	/* JPEG segment table, palloc'ed */
+	struct ExifSegmentCacheEntry *cached;	/* shared table of external value */
+	ExifCoreSource		src;		/* the reader as source for the core */
+} ExifByteaReader;
+
+/* bytea_exif.c */
+extern char *escapeJson(const char* json);
+extern bool exif_data_datetime(ExifData *edata, ExifTag tag_dt, bool use_offset, TimestampTz *result);
+extern bool exif_tm_to_timestamptz(const ExifCoreDateTime *dt, TimestampTz *result);
+extern void exif_summary_values(ExifCoreSummary *s, int64 len, Datum *values, bool *nulls);
+
+/* bytea_exif_segment.c */
+extern void exif_reader_init(ExifByteaReader *r, Datum d);
+extern const unsigned char *exif_reader_fetch(ExifByteaReader *r, int64 off, int32 len);
+extern void exif_reader_free(ExifByteaReader *r);
+extern bool exif_is_jpeg(ExifByteaReader *r);
+extern bool exif_jpeg_next_segment(ExifByteaReader *r, int *i, ExifJpegSegment *seg);
+
+/* bytea_exif_container.c */
+extern int64 exif_datum_size(Datum d);
+extern ExifData *exif_data_from_datum(Datum d);
+extern ExifData *exif_data_from_datum_makernote(Datum d);
+
+/* bytea_exif_worker.c */
+extern void exif_worker_init(void);
+
+/* bytea_exif_batch.c */
+extern void exif_batch_init(void);
+
+/* bytea_exif_diag.c */
+extern void exif_diag_init(void);
+extern void exif_report_status(ExifCoreStatus status, ExifCoreInfo *info, int64 len);
+extern void exif_report_tag_name(const char *tagname);
+extern void exif_report_xmp(bool xml, int64 len);
+
 #endif	/* BYTEA_EXIF_H */
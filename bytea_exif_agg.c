@@ -0,0 +1,501 @@
+/*-------------------------------------------------------------------------
+ *
+ * EXIF data extractor for PotgreSQL bytea data
+ * Aggregate functions
+ *
+ * (c) 2025, mkgrgis
+ *
+ * IDENTIFICATION
+ *		bytea_exif_agg.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "bytea_exif.h"
+
+#include "fmgr.h"
+#include "catalog/pg_type.h"
+#include "libpq/pqformat.h"
+#include "mb/pg_wchar.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/hsearch.h"
+#include "utils/jsonb.h"
+#include "utils/memutils.h"
+#include "utils/numeric.h"
+#if PG_VERSION_NUM >= 160000
+	#include "varatt.h"
+#endif
+
+Datum exif_tag_histogram_transfn(PG_FUNCTION_ARGS);
+Datum exif_tag_histogram_combinefn(PG_FUNCTION_ARGS);
+Datum exif_tag_histogram_serialfn(PG_FUNCTION_ARGS);
+Datum exif_tag_histogram_deserialfn(PG_FUNCTION_ARGS);
+Datum exif_tag_histogram_finalfn(PG_FUNCTION_ARGS);
+
+PG_FUNCTION_INFO_V1(exif_tag_histogram_transfn);
+PG_FUNCTION_INFO_V1(exif_tag_histogram_combinefn);
+PG_FUNCTION_INFO_V1(exif_tag_histogram_serialfn);
+PG_FUNCTION_INFO_V1(exif_tag_histogram_deserialfn);
+PG_FUNCTION_INFO_V1(exif_tag_histogram_finalfn);
+
+/*
+ * Histogram key: number of a tag in the tag list of the aggregate state
+ * and a text value of the tag. The value string is allocated in aggregate
+ * memory context together with the hash table entry.
+ */
+typedef struct ExifHistKey
+{
+	int			tagno;
+	char	   *value;
+} ExifHistKey;
+
+typedef struct ExifHistEntry
+{
+	ExifHistKey	key;		/* must be first */
+	int64		count;
+} ExifHistEntry;
+
+/*
+ * Internal state of exif_tag_histogram aggregate.
+ * Tag list is taken from the first not NULL tag array argument.
+ */
+typedef struct ExifHistState
+{
+	MemoryContext	mcxt;		/* aggregate memory context */
+	int				ntags;
+	char		  **tagnames;
+	ArrayType	   *tags;		/* copy of checked tag array or NULL */
+	HTAB		   *hist;
+} ExifHistState;
+
+static uint32
+exif_hist_hash(const void *key, Size keysize)
+{
+	const ExifHistKey *k = (const ExifHistKey *) key;
+	const unsigned char *p = (const unsigned char *) k->value;
+	uint32		h = 2166136261u ^ (uint32) k->tagno;
+
+	/* FNV-1a, values are short text strings */
+	for (; *p; p++)
+	{
+		h ^= *p;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static int
+exif_hist_match(const void *key1, const void *key2, Size keysize)
+{
+	const ExifHistKey *k1 = (const ExifHistKey *) key1;
+	const ExifHistKey *k2 = (const ExifHistKey *) key2;
+
+	if (k1->tagno != k2->tagno)
+		return 1;
+	return strcmp(k1->value, k2->value);
+}
+
+static ExifHistState *
+exif_hist_state_new(MemoryContext mcxt, int ntags)
+{
+	ExifHistState  *state = MemoryContextAllocZero(mcxt, sizeof(ExifHistState));
+	HASHCTL			ctl;
+
+	memset(&ctl, 0, sizeof(ctl));
+	ctl.keysize = sizeof(ExifHistKey);
+	ctl.entrysize = sizeof(ExifHistEntry);
+	ctl.hash = exif_hist_hash;
+	ctl.match = exif_hist_match;
+	ctl.hcxt = mcxt;
+
+	state->mcxt = mcxt;
+	state->ntags = ntags;
+	state->tagnames = MemoryContextAllocZero(mcxt, sizeof(char *) * Max(ntags, 1));
+	state->hist = hash_create("bytea_exif tag histogram", 64, &ctl,
+							  HASH_ELEM | HASH_FUNCTION | HASH_COMPARE | HASH_CONTEXT);
+	return state;
+}
+
+/*
+ * exif_hist_add
+ * Adds count to a tag value counter, the value is copied on first use.
+ */
+static void
+exif_hist_add(ExifHistState *state, int tagno, const char *value, int64 count)
+{
+	ExifHistKey		key;
+	ExifHistEntry  *entry;
+	bool			found;
+
+	key.tagno = tagno;
+	key.value = (char *) value;
+	entry = (ExifHistEntry *) hash_search(state->hist, &key, HASH_ENTER, &found);
+	if (!found)
+	{
+		entry->key.value = MemoryContextStrdup(state->mcxt, value);
+		entry->count = 0;
+	}
+	entry->count += count;
+}
+
+static int
+exif_hist_tagno(ExifHistState *state, const char *tagname)
+{
+	for (int i = 0; i < state->ntags; i++)
+	{
+		if (strcmp(state->tagnames[i], tagname) == 0)
+			return i;
+	}
+	return -1;
+}
+
+/*
+ * exif_hist_check_tags
+ * Checks tag array of a row against tag list of the state. The same check is
+ * done for partial states in combinefn. Usually the array of all rows is the
+ * same, hence it is compared with the copy of the array checked before and
+ * deconstructed only if the bytes differ.
+ */
+static void
+exif_hist_check_tags(ExifHistState *state, ArrayType *tags)
+{
+	Datum	   *tag_datums;
+	bool	   *tag_nulls;
+	int			ntags;
+
+	if (state->tags != NULL && VARSIZE(state->tags) == VARSIZE(tags) &&
+		memcmp(state->tags, tags, VARSIZE(tags)) == 0)
+		return;
+
+	deconstruct_array(tags, TEXTOID, -1, false, 'i',
+					  &tag_datums, &tag_nulls, &ntags);
+	for (int i = 0; i < ntags; i++)
+	{
+		if (tag_nulls[i])
+			ereport(ERROR,
+				(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+				 errmsg("Tag name array must not contain NULL values")));
+		if (i >= state->ntags || strcmp(state->tagnames[i], TextDatumGetCString(tag_datums[i])) != 0)
+			ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("Tag name array must be the same for all rows of the aggregate"),
+				 errhint("Tag \"%s\" is not in the tag name array of the first row", TextDatumGetCString(tag_datums[i]))));
+	}
+	if (ntags != state->ntags)
+		ereport(ERROR,
+			(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+			 errmsg("Tag name array must be the same for all rows of the aggregate"),
+			 errhint("Tag \"%s\" is not in the tag name array of the row", state->tagnames[ntags])));
+	pfree(tag_datums);
+	pfree(tag_nulls);
+	if (state->tags == NULL)
+		state->tags = (ArrayType *) MemoryContextAlloc(state->mcxt, VARSIZE(tags));
+	else if (VARSIZE(state->tags) != VARSIZE(tags))
+		state->tags = (ArrayType *) repalloc(state->tags, VARSIZE(tags));
+	memcpy(state->tags, tags, VARSIZE(tags));
+}
+
+/*
+ * exif_tag_histogram_transfn
+ * Parses EXIF data of an image once and counts values of all listed tags.
+ * Only the first entry of a tag is counted like in bytea_get_exif_tag_value.
+ */
+Datum
+exif_tag_histogram_transfn(PG_FUNCTION_ARGS)
+{
+	MemoryContext	aggcontext;
+	ExifHistState  *state = PG_ARGISNULL(0) ? NULL : (ExifHistState *) PG_GETARG_POINTER(0);
+	ExifData	   *edata = NULL;
+	bool		   *seen = NULL;
+	int				nseen = 0;
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+		elog(ERROR, "exif_tag_histogram_transfn called in non-aggregate context");
+
+	if (state == NULL)
+	{
+		ArrayType  *tags;
+		Datum	   *tag_datums;
+		bool	   *tag_nulls;
+		int			ntags;
+
+		if (PG_ARGISNULL(2))
+			PG_RETURN_NULL();
+
+		tags = PG_GETARG_ARRAYTYPE_P(2);
+		deconstruct_array(tags, TEXTOID, -1, false, 'i',
+						  &tag_datums, &tag_nulls, &ntags);
+		state = exif_hist_state_new(aggcontext, ntags);
+		for (int i = 0; i < ntags; i++)
+		{
+			if (tag_nulls[i])
+				ereport(ERROR,
+					(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+					 errmsg("Tag name array must not contain NULL values")));
+			state->tagnames[i] = MemoryContextStrdup(aggcontext, TextDatumGetCString(tag_datums[i]));
+			/* values would be counted only for the first of the same names */
+			for (int j = 0; j < i; j++)
+			{
+				if (strcmp(state->tagnames[j], state->tagnames[i]) == 0)
+					ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("Tag name array must not contain duplicate tag names"),
+						 errhint("Tag \"%s\" is listed more than once", state->tagnames[i])));
+			}
+		}
+		state->tags = (ArrayType *) MemoryContextAlloc(aggcontext, VARSIZE(tags));
+		memcpy(state->tags, tags, VARSIZE(tags));
+	}
+	else if (!PG_ARGISNULL(2))
+		exif_hist_check_tags(state, PG_GETARG_ARRAYTYPE_P(2));
+
+	if (PG_ARGISNULL(1) || state->ntags == 0)
+		PG_RETURN_POINTER(state);
+
+	edata = exif_data_from_datum(PG_GETARG_DATUM(1));
+	if (edata == NULL) /* no EXIF data structure */
+		PG_RETURN_POINTER(state);
+
+	seen = palloc0(sizeof(bool) * state->ntags);
+	for (unsigned j = 0; j < EXIF_IFD_COUNT && nseen < state->ntags; j++)
+	{
+		ExifContent	   *content = edata->ifd[j];
+
+		if (!content) /* no EXIF data */
+			continue;
+
+		for (unsigned int i = 0; i < content->count && nseen < state->ntags; i++)
+		{
+			ExifEntry	   *ee = content->entries[i];
+			const char	   *tname = exif_tag_get_name_in_ifd(ee->tag, j);
+			int				tagno;
+			char			buf0[EXIF_CORE_VALUE_LEN];
+
+			if (tname == NULL)
+				continue;
+			tagno = exif_hist_tagno(state, tname);
+			if (tagno < 0 || seen[tagno])
+				continue;
+
+			seen[tagno] = true;
+			nseen++;
+			exif_entry_get_value(ee, buf0, sizeof(buf0));
+			/* raw bytes of broken ASCII values are not a text */
+			if (!pg_verifymbstr(buf0, strlen(buf0), true))
+				continue;
+			exif_hist_add(state, tagno, buf0, 1);
+		}
+	} /* ifd */
+
+	pfree(seen);
+	exif_data_free (edata);
+	PG_RETURN_POINTER(state);
+}
+
+/*
+ * exif_tag_histogram_combinefn
+ * Merges two partial histograms, tags are matched by name.
+ */
+Datum
+exif_tag_histogram_combinefn(PG_FUNCTION_ARGS)
+{
+	MemoryContext	aggcontext;
+	ExifHistState  *state1 = PG_ARGISNULL(0) ? NULL : (ExifHistState *) PG_GETARG_POINTER(0);
+	ExifHistState  *state2 = PG_ARGISNULL(1) ? NULL : (ExifHistState *) PG_GETARG_POINTER(1);
+	HASH_SEQ_STATUS	status;
+	ExifHistEntry  *entry;
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+		elog(ERROR, "exif_tag_histogram_combinefn called in non-aggregate context");
+
+	if (state2 == NULL)
+	{
+		if (state1 == NULL)
+			PG_RETURN_NULL();
+		PG_RETURN_POINTER(state1);
+	}
+
+	if (state1 == NULL)
+	{
+		state1 = exif_hist_state_new(aggcontext, state2->ntags);
+		for (int i = 0; i < state2->ntags; i++)
+			state1->tagnames[i] = MemoryContextStrdup(aggcontext, state2->tagnames[i]);
+	}
+
+	hash_seq_init(&status, state2->hist);
+	while ((entry = (ExifHistEntry *) hash_seq_search(&status)) != NULL)
+	{
+		int		tagno = exif_hist_tagno(state1, state2->tagnames[entry->key.tagno]);
+
+		if (tagno < 0)
+			ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("Tag name array must be the same for all rows of the aggregate"),
+				 errhint("Tag \"%s\" was not found in other partial aggregate state", state2->tagnames[entry->key.tagno])));
+		exif_hist_add(state1, tagno, entry->key.value, entry->count);
+	}
+
+	PG_RETURN_POINTER(state1);
+}
+
+/*
+ * exif_tag_histogram_serialfn
+ * Format: tag count, tag names, entry count, entries as
+ * (tag number, counter, value). Strings are length prefixed.
+ */
+Datum
+exif_tag_histogram_serialfn(PG_FUNCTION_ARGS)
+{
+	ExifHistState  *state = (ExifHistState *) PG_GETARG_POINTER(0);
+	StringInfoData	buf;
+	HASH_SEQ_STATUS	status;
+	ExifHistEntry  *entry;
+
+	if (!AggCheckCallContext(fcinfo, NULL))
+		elog(ERROR, "exif_tag_histogram_serialfn called in non-aggregate context");
+
+	pq_begintypsend(&buf);
+	pq_sendint(&buf, state->ntags, 4);
+	for (int i = 0; i < state->ntags; i++)
+	{
+		int		l = strlen(state->tagnames[i]);
+
+		pq_sendint(&buf, l, 4);
+		pq_sendbytes(&buf, state->tagnames[i], l);
+	}
+
+	pq_sendint(&buf, (int32) hash_get_num_entries(state->hist), 4);
+	hash_seq_init(&status, state->hist);
+	while ((entry = (ExifHistEntry *) hash_seq_search(&status)) != NULL)
+	{
+		int		l = strlen(entry->key.value);
+
+		pq_sendint(&buf, entry->key.tagno, 4);
+		pq_sendint64(&buf, entry->count);
+		pq_sendint(&buf, l, 4);
+		pq_sendbytes(&buf, entry->key.value, l);
+	}
+
+	PG_RETURN_BYTEA_P(pq_endtypsend(&buf));
+}
+
+Datum
+exif_tag_histogram_deserialfn(PG_FUNCTION_ARGS)
+{
+	MemoryContext	aggcontext;
+	bytea		   *sstate = PG_GETARG_BYTEA_PP(0);
+	ExifHistState  *state;
+	StringInfoData	buf;
+	int				ntags;
+	int				nentries;
+
+	if (!AggCheckCallContext(fcinfo, &aggcontext))
+		elog(ERROR, "exif_tag_histogram_deserialfn called in non-aggregate context");
+
+	initStringInfo(&buf);
+	appendBinaryStringInfo(&buf, VARDATA_ANY(sstate), VARSIZE_ANY_EXHDR(sstate));
+
+	ntags = pq_getmsgint(&buf, 4);
+	state = exif_hist_state_new(aggcontext, ntags);
+	for (int i = 0; i < ntags; i++)
+	{
+		int		l = pq_getmsgint(&buf, 4);
+
+		state->tagnames[i] = MemoryContextAllocZero(aggcontext, l + 1);
+		memcpy(state->tagnames[i], pq_getmsgbytes(&buf, l), l);
+	}
+
+	nentries = pq_getmsgint(&buf, 4);
+	for (int i = 0; i < nentries; i++)
+	{
+		int		tagno = pq_getmsgint(&buf, 4);
+		int64	count = pq_getmsgint64(&buf);
+		int		l = pq_getmsgint(&buf, 4);
+		char   *value = palloc(l + 1);
+
+		memcpy(value, pq_getmsgbytes(&buf, l), l);
+		value[l] = '\0';
+		exif_hist_add(state, tagno, value, count);
+		pfree(value);
+	}
+
+	pq_getmsgend(&buf);
+	pfree(buf.data);
+
+	PG_RETURN_POINTER(state);
+}
+
+static int
+exif_hist_entry_cmp(const void *a, const void *b)
+{
+	const ExifHistEntry *e1 = *(ExifHistEntry * const *) a;
+	const ExifHistEntry *e2 = *(ExifHistEntry * const *) b;
+
+	if (e1->key.tagno != e2->key.tagno)
+		return e1->key.tagno < e2->key.tagno ? -1 : 1;
+	return strcmp(e1->key.value, e2->key.value);
+}
+
+static void
+exif_hist_push_string(JsonbParseState **pstate, JsonbIteratorToken seq, char *str)
+{
+	JsonbValue	v;
+
+	v.type = jbvString;
+	v.val.string.val = str;
+	v.val.string.len = strlen(str);
+	pushJsonbValue(pstate, seq, &v);
+}
+
+/*
+ * exif_tag_histogram_finalfn
+ * Returns jsonb as {tag : {value : count, ...}, ...}
+ * Tags without any value in all of images are presented as empty objects.
+ * jsonb is built from values without parsing of JSON text, hence any
+ * character of a value is escaped on output.
+ */
+Datum
+exif_tag_histogram_finalfn(PG_FUNCTION_ARGS)
+{
+	ExifHistState  *state = PG_ARGISNULL(0) ? NULL : (ExifHistState *) PG_GETARG_POINTER(0);
+	JsonbParseState *pstate = NULL;
+	JsonbValue	   *res;
+	ExifHistEntry **entries;
+	long			nentries;
+	long			k = 0;
+	HASH_SEQ_STATUS	status;
+	ExifHistEntry  *entry;
+
+	if (state == NULL)
+		PG_RETURN_NULL();
+
+	nentries = hash_get_num_entries(state->hist);
+	entries = palloc(sizeof(ExifHistEntry *) * Max(nentries, 1));
+	hash_seq_init(&status, state->hist);
+	while ((entry = (ExifHistEntry *) hash_seq_search(&status)) != NULL)
+		entries[k++] = entry;
+	qsort(entries, nentries, sizeof(ExifHistEntry *), exif_hist_entry_cmp);
+
+	pushJsonbValue(&pstate, WJB_BEGIN_OBJECT, NULL);
+	k = 0;
+	for (int i = 0; i < state->ntags; i++)
+	{
+		exif_hist_push_string(&pstate, WJB_KEY, state->tagnames[i]);
+		pushJsonbValue(&pstate, WJB_BEGIN_OBJECT, NULL);
+		for (; k < nentries && entries[k]->key.tagno == i; k++)
+		{
+			JsonbValue	v;
+
+			exif_hist_push_string(&pstate, WJB_KEY, entries[k]->key.value);
+			v.type = jbvNumeric;
+			v.val.numeric = DatumGetNumeric(DirectFunctionCall1(int8_numeric, Int64GetDatum(entries[k]->count)));
+			pushJsonbValue(&pstate, WJB_VALUE, &v);
+		}
+		pushJsonbValue(&pstate, WJB_END_OBJECT, NULL);
+	}
+	res = pushJsonbValue(&pstate, WJB_END_OBJECT, NULL);
+
+	PG_RETURN_POINTER(JsonbValueToJsonb(res));
+}
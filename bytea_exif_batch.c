@@ -0,0 +1,346 @@
+/*-------------------------------------------------------------------------
+ *
+ * EXIF data extractor for PotgreSQL bytea data
+ * Batch parsing of bytea[] by a pool of threads inside the backend
+ *
+ * Only the core code without PostgreSQL calls is executed by the threads.
+ * All of array elements are detoasted before start of the threads and all of
+ * results are converted to datums with problem reports after the threads are
+ * joined, hence no palloc or ereport can be called in parallel. The backend
+ * checks for interrupts between items and stops the threads before ERROR.
+ *
+ * (c) 2025, mkgrgis
+ *
+ * IDENTIFICATION
+ *		bytea_exif_batch.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "bytea_exif.h"
+
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+
+#include "catalog/pg_type.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/tuplestore.h"
+
+Datum bytea_exif_summary_batch(PG_FUNCTION_ARGS);
+
+PG_FUNCTION_INFO_V1(bytea_exif_summary_batch);
+
+/* GUC variables */
+static int	exif_batch_threads = 4;
+
+/* One array element, data is detoasted by the backend */
+typedef struct ExifBatchItem
+{
+	const unsigned char *data;
+	int64				size;
+	bool				isnull;
+	ExifCoreSummary		s;
+} ExifBatchItem;
+
+typedef struct ExifBatch
+{
+	ExifBatchItem	   *items;
+	int					nitems;
+	int					next;		/* next item for a thread */
+	int					running;	/* started threads not finished */
+	bool				stop;		/* no more items, the backend ERRORs */
+	pthread_mutex_t		lock;
+	pthread_cond_t		done;		/* signalled when a thread finishes */
+} ExifBatch;
+
+/*
+ * exif_batch_init
+ * Defines GUC variables. Called from _PG_init.
+ */
+void
+exif_batch_init(void)
+{
+	DefineCustomIntVariable("bytea_exif.batch_threads",
+							"Maximal number of threads of bytea_exif_summary_batch.",
+							"1 means parsing without additional threads.",
+							&exif_batch_threads,
+							4,
+							1,
+							64,
+							PGC_USERSET,
+							0,
+							NULL, NULL, NULL);
+}
+
+static const unsigned char *
+exif_batch_fetch(void *arg, int64_t off, int32_t len)
+{
+	ExifBatchItem  *item = (ExifBatchItem *) arg;
+
+	if (off < 0 || len < 0 || off + len > item->size)
+		return NULL;
+	return item->data + off;
+}
+
+/*
+ * exif_batch_item
+ * Extracts summary of one element. Core code only, can run in a thread.
+ */
+static void
+exif_batch_item(ExifBatchItem *item)
+{
+	ExifCoreSource		src = {exif_batch_fetch, item, item->size, NULL};
+	ExifCoreContainer	container;
+	ExifData		   *edata = NULL;
+
+	if (item->size > 0)
+	{
+		edata = exif_core_data_from_source(&src, &container, 0);
+		if (container == EXIF_CONTAINER_OTHER)
+			edata = exif_core_loader(item->data, item->size, 0);
+	}
+	exif_core_summary(edata, &item->s);
+	if (edata != NULL)
+		exif_data_free (edata);
+}
+
+/*
+ * exif_batch_claim
+ * Returns number of next item to parse or -1 if there are no more items or
+ * the batch is stopped.
+ */
+static int
+exif_batch_claim(ExifBatch *b)
+{
+	int			i = -1;
+
+	pthread_mutex_lock(&b->lock);
+	if (!b->stop && b->next < b->nitems)
+		i = b->next++;
+	pthread_mutex_unlock(&b->lock);
+	return i;
+}
+
+static void *
+exif_batch_thread(void *arg)
+{
+	ExifBatch  *b = (ExifBatch *) arg;
+	int			i;
+
+	while ((i = exif_batch_claim(b)) >= 0)
+	{
+		if (!b->items[i].isnull)
+			exif_batch_item(&b->items[i]);
+	}
+
+	pthread_mutex_lock(&b->lock);
+	b->running--;
+	pthread_cond_signal(&b->done);
+	pthread_mutex_unlock(&b->lock);
+	return NULL;
+}
+
+/*
+ * exif_batch_wait
+ * Waits for all of the threads with check for interrupts. Wait is limited
+ * by 100 ms hence a cancel is processed while threads parse long items.
+ */
+static void
+exif_batch_wait(ExifBatch *b)
+{
+	for (;;)
+	{
+		struct timespec	ts;
+		int				running;
+
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_nsec += 100 * 1000 * 1000;
+		if (ts.tv_nsec >= 1000 * 1000 * 1000)
+		{
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000 * 1000 * 1000;
+		}
+		pthread_mutex_lock(&b->lock);
+		if (b->running > 0)
+			pthread_cond_timedwait(&b->done, &b->lock, &ts);
+		running = b->running;
+		pthread_mutex_unlock(&b->lock);
+		if (running == 0)
+			break;
+		CHECK_FOR_INTERRUPTS();
+	}
+}
+
+/*
+ * exif_batch_run
+ * Runs threads for the batch, the backend is one of the workers. Signals are
+ * blocked in the threads, they are delivered only to the backend. If the
+ * backend gets ERROR, for example on cancel, other threads get no more items
+ * and are joined before the ERROR is rethrown.
+ */
+static void
+exif_batch_run(ExifBatch *b)
+{
+	int			nthreads = Min(exif_batch_threads, b->nitems) - 1;
+	pthread_t  *threads = NULL;
+	int			started = 0;
+
+	if (nthreads > 0)
+	{
+		sigset_t	all;
+		sigset_t	old;
+
+		threads = (pthread_t *) palloc(sizeof(pthread_t) * nthreads);
+		sigfillset(&all);
+		pthread_sigmask(SIG_SETMASK, &all, &old);
+		for (; started < nthreads; started++)
+		{
+			/* not started threads are replaced by the backend */
+			b->running++;
+			if (pthread_create(&threads[started], NULL, exif_batch_thread, b) != 0)
+			{
+				b->running--;
+				break;
+			}
+		}
+		pthread_sigmask(SIG_SETMASK, &old, NULL);
+	}
+
+	PG_TRY();
+	{
+		int			i;
+
+		while ((i = exif_batch_claim(b)) >= 0)
+		{
+			if (!b->items[i].isnull)
+				exif_batch_item(&b->items[i]);
+			CHECK_FOR_INTERRUPTS();
+		}
+		exif_batch_wait(b);
+	}
+	PG_CATCH();
+	{
+		pthread_mutex_lock(&b->lock);
+		b->stop = true;
+		pthread_mutex_unlock(&b->lock);
+		for (int i = 0; i < started; i++)
+			pthread_join(threads[i], NULL);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	for (int i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+	if (threads != NULL)
+		pfree(threads);
+}
+
+/*
+ * exif_batch_free
+ * Frees strings of summaries which are not converted to datums.
+ */
+static void
+exif_batch_free(ExifBatch *b)
+{
+	for (int i = 0; i < b->nitems; i++)
+		exif_core_summary_free(&b->items[i].s);
+}
+
+/*
+ * bytea_exif_summary_batch
+ * bytea_exif_summary for all elements of bytea[] with element number.
+ */
+Datum
+bytea_exif_summary_batch(PG_FUNCTION_ARGS)
+{
+	ArrayType	   *arr = PG_GETARG_ARRAYTYPE_P(0);
+	ReturnSetInfo  *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc		tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext	oldcontext;
+	Datum		   *elems;
+	bool		   *elem_nulls;
+	int				nelems;
+	int				lbound;
+	ExifBatch	   *b;
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("materialize mode required, but it is not allowed in this context")));
+
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("function returning record called in context that cannot accept type record")));
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+	MemoryContextSwitchTo(oldcontext);
+
+	deconstruct_array(arr, BYTEAOID, -1, false, 'i',
+					  &elems, &elem_nulls, &nelems);
+	lbound = nelems > 0 ? ARR_LBOUND(arr)[0] : 1;
+
+	/* detoast all of elements before the threads */
+	b = (ExifBatch *) palloc0(sizeof(ExifBatch));
+	b->items = (ExifBatchItem *) palloc0(sizeof(ExifBatchItem) * Max(nelems, 1));
+	b->nitems = nelems;
+	for (int i = 0; i < nelems; i++)
+	{
+		b->items[i].isnull = elem_nulls[i];
+		if (!elem_nulls[i])
+		{
+			bytea	   *v = DatumGetByteaPP(elems[i]);
+
+			b->items[i].data = (const unsigned char *) VARDATA_ANY(v);
+			b->items[i].size = VARSIZE_ANY_EXHDR(v);
+		}
+	}
+
+	pthread_mutex_init(&b->lock, NULL);
+	pthread_cond_init(&b->done, NULL);
+	PG_TRY();
+	{
+		exif_batch_run(b);
+		for (int i = 0; i < nelems; i++)
+		{
+			Datum		values[EXIF_SUMMARY_NATTS + 1];
+			bool		nulls[EXIF_SUMMARY_NATTS + 1];
+
+			CHECK_FOR_INTERRUPTS();
+			values[0] = Int32GetDatum(lbound + i);
+			nulls[0] = false;
+			if (b->items[i].isnull)
+				memset(nulls + 1, true, sizeof(bool) * EXIF_SUMMARY_NATTS);
+			else
+				exif_summary_values(&b->items[i].s, b->items[i].size, values + 1, nulls + 1);
+			tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+		}
+	}
+	PG_CATCH();
+	{
+		/* summaries of parsed but not converted items */
+		exif_batch_free(b);
+		pthread_cond_destroy(&b->done);
+		pthread_mutex_destroy(&b->lock);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	pthread_cond_destroy(&b->done);
+	pthread_mutex_destroy(&b->lock);
+	return (Datum) 0;
+}
@@ -0,0 +1,137 @@
+/*-------------------------------------------------------------------------
+ *
+ * EXIF data extractor for PotgreSQL bytea data
+ * bytea_exif_bench: microbenchmark of JPEG marker scanning of the core,
+ * scalar version against the vector version selected for the CPU
+ *
+ * Usage: bytea_exif_bench [-n loops] file ...
+ *
+ * (c) 2025, mkgrgis
+ *
+ * IDENTIFICATION
+ *		bytea_exif_bench.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bytea_exif_core.h"
+
+typedef size_t (*BenchScan) (const unsigned char *p, size_t len);
+
+static double
+bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * bench_scan
+ * Finds all of 0xFF bytes of the data loops times, returns the count of
+ * the bytes in the data and scan time in seconds.
+ */
+static size_t
+bench_scan(BenchScan scan, const unsigned char *p, size_t len, int loops, double *sec)
+{
+	size_t		count = 0;
+	double		start = bench_now();
+
+	for (int l = 0; l < loops; l++)
+	{
+		size_t		off = 0;
+
+		count = 0;
+		while (off < len)
+		{
+			off += scan(p + off, len - off);
+			if (off < len)
+			{
+				count++;
+				off++;
+			}
+		}
+	}
+	*sec = bench_now() - start;
+	return count;
+}
+
+int
+main(int argc, char **argv)
+{
+	int			loops = 20;
+	int			c;
+
+	while ((c = getopt(argc, argv, "n:")) != -1)
+	{
+		if (c == 'n' && atoi(optarg) > 0)
+			loops = atoi(optarg);
+		else
+		{
+			fprintf(stderr, "Usage: bytea_exif_bench [-n loops] file ...\n");
+			return 1;
+		}
+	}
+	if (optind >= argc)
+	{
+		fprintf(stderr, "Usage: bytea_exif_bench [-n loops] file ...\n");
+		return 1;
+	}
+
+	printf("%-40s %12s %10s %12s %12s %8s\n", "file", "bytes", "markers",
+		   "scalar MB/s", "simd MB/s", "simd");
+	for (int i = optind; i < argc; i++)
+	{
+		int			fd = open(argv[i], O_RDONLY);
+		struct stat	st;
+		void	   *base;
+		size_t		n_scalar;
+		size_t		n_simd;
+		double		t_scalar;
+		double		t_simd;
+		double		mb;
+
+		if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0)
+		{
+			fprintf(stderr, "bytea_exif_bench: could not read \"%s\": %s\n", argv[i], strerror(errno));
+			if (fd >= 0)
+				close(fd);
+			continue;
+		}
+		base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (base == MAP_FAILED)
+		{
+			fprintf(stderr, "bytea_exif_bench: could not map \"%s\": %s\n", argv[i], strerror(errno));
+			continue;
+		}
+
+		/* warm page cache */
+		bench_scan(exif_core_find_marker, base, st.st_size, 1, &t_simd);
+		n_scalar = bench_scan(exif_core_find_marker_scalar, base, st.st_size, loops, &t_scalar);
+		n_simd = bench_scan(exif_core_find_marker, base, st.st_size, loops, &t_simd);
+		munmap(base, st.st_size);
+
+		if (n_scalar != n_simd)
+		{
+			fprintf(stderr, "bytea_exif_bench: \"%s\": scalar found %zu markers, %s found %zu\n",
+					argv[i], n_scalar, exif_core_simd_name(), n_simd);
+			return 2;
+		}
+		mb = (double) st.st_size * loops / (1024 * 1024);
+		printf("%-40s %12lld %10zu %12.1f %12.1f %8s\n", argv[i], (long long) st.st_size,
+			   n_simd, mb / t_scalar, mb / t_simd, exif_core_simd_name());
+	}
+	return 0;
+}
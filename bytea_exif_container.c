@@ -0,0 +1,118 @@
+/*-------------------------------------------------------------------------
+ *
+ * EXIF data extractor for PotgreSQL bytea data
+ * Container front end for libexif: EXIF block of JPEG, PNG, WebP and
+ * HEIF/AVIF data is located by the core with slice reads of bytea values
+ *
+ * (c) 2025, mkgrgis
+ *
+ * IDENTIFICATION
+ *		bytea_exif_container.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "bytea_exif.h"
+
+#include "fmgr.h"
+#include "utils/builtins.h"
+#if PG_VERSION_NUM >= 130000
+	#include "access/detoast.h"
+#else
+	#include "access/tuptoaster.h"
+#endif
+#if PG_VERSION_NUM >= 160000
+	#include "varatt.h"
+#endif
+
+Datum bytea_exif_fingerprint(PG_FUNCTION_ARGS);
+
+PG_FUNCTION_INFO_V1(bytea_exif_fingerprint);
+
+/*
+ * exif_datum_size
+ * Size of bytea data without detoasting.
+ */
+int64
+exif_datum_size(Datum d)
+{
+	return toast_raw_datum_size(d) - VARHDRSZ;
+}
+
+/*
+ * exif_data_load_datum
+ * Container aware front end for libexif. Locates EXIF block in JPEG, PNG,
+ * WebP or HEIF/AVIF data by slice reads and loads only this block.
+ * Other data is given to libexif loader as is. MakerNote is interpreted only
+ * if makernote is true.
+ * Returns NULL if there is no EXIF data structure.
+ */
+static ExifData *
+exif_data_load_datum(Datum d, bool makernote)
+{
+	ExifByteaReader		r;
+	ExifCoreContainer	container;
+	ExifData		   *edata = NULL;
+
+	exif_reader_init(&r, d);
+	if (r.size == 0) /* no data */
+		return NULL;
+
+	edata = exif_core_data_from_source(&r.src, &container, makernote);
+	exif_reader_free(&r);
+
+	if (container == EXIF_CONTAINER_OTHER)
+	{
+		/* raw EXIF data or other formats of libexif loader */
+		bytea	   *arg = DatumGetByteaPP(d);
+
+		edata = exif_core_loader((const unsigned char *) VARDATA_ANY(arg), VARSIZE_ANY_EXHDR(arg), makernote);
+	}
+	return edata;
+}
+
+/*
+ * exif_data_from_datum
+ * EXIF data without MakerNote interpretation, MakerNote entry is kept as
+ * undefined data.
+ */
+ExifData *
+exif_data_from_datum(Datum d)
+{
+	return exif_data_load_datum(d, false);
+}
+
+/*
+ * exif_data_from_datum_makernote
+ * EXIF data with interpreted MakerNote for exif_data_get_mnote_data.
+ */
+ExifData *
+exif_data_from_datum_makernote(Datum d)
+{
+	return exif_data_load_datum(d, true);
+}
+
+/*
+ * bytea_exif_fingerprint
+ * 64 bit hash of TIFF payload of EXIF block. Only container headers and EXIF
+ * block are read, not the image data, hence the hash doesn't change after
+ * recompression of the image with the same EXIF data.
+ */
+Datum
+bytea_exif_fingerprint(PG_FUNCTION_ARGS)
+{
+	Datum				arg = PG_GETARG_DATUM(0);
+	ExifByteaReader		r;
+	uint64_t			hash;
+	bool				found;
+
+	exif_reader_init(&r, arg);
+	if (r.size == 0) /* no data */
+		PG_RETURN_NULL();
+	found = exif_core_fingerprint(&r.src, &hash) != 0;
+	exif_reader_free(&r);
+	if (!found) /* no EXIF block */
+		PG_RETURN_NULL();
+	PG_RETURN_INT64((int64) hash);
+}
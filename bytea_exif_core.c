@@ -0,0 +1,1611 @@
+/*-------------------------------------------------------------------------
+ *
+ * EXIF data extractor for PotgreSQL bytea data
+ * PostgreSQL independent core: container front end for libexif, GPS,
+ * date and time and UserComment decoding. This code is linked both to the
+ * extension and to bytea_exif_extract, hence loaded data and in-database
+ * extraction give the same values. No PostgreSQL calls are allowed here,
+ * the functions can be used by many threads.
+ *
+ * (c) 2025, mkgrgis
+ *
+ * IDENTIFICATION
+ *		bytea_exif_core.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <errno.h>
+#include <iconv.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-loader.h>
+#include <libexif/exif-utils.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define EXIF_CORE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#include "bytea_exif_core.h"
+
+/* Header of EXIF block expected by exif_data_load_data */
+static const unsigned char ExifHeader[] = {'E', 'x', 'i', 'f', 0, 0};
+#define EXIF_HEADER_LEN		6
+/* Window for marker search in corrupted JPEG data */
+#define EXIF_SCAN_WINDOW	(64 * 1024)
+/* Maximal size of EXIF block in not JPEG containers */
+#define EXIF_MAX_BLOCK_LEN	(16 * 1024 * 1024)
+
+static const unsigned char PngSignature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+static const int day_tab[2][12] = {
+	{31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31},
+	{31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31}
+};
+#define IS_LEAP(y) (((y) % 4) == 0 && (((y) % 100) != 0 || ((y) % 400) == 0))
+
+static uint32_t
+exif_get_be32(const unsigned char *p)
+{
+	return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+}
+
+static uint32_t
+exif_get_le32(const unsigned char *p)
+{
+	return ((uint32_t) p[3] << 24) | ((uint32_t) p[2] << 16) | ((uint32_t) p[1] << 8) | (uint32_t) p[0];
+}
+
+static uint64_t
+exif_get_be(const unsigned char *p, int n)
+{
+	uint64_t	v = 0;
+
+	for (int i = 0; i < n; i++)
+		v = (v << 8) | p[i];
+	return v;
+}
+
+#define FETCH(src, off, len) ((src)->fetch((src)->arg, (off), (len)))
+
+/*
+ * Marker scanning. Returns index of the first 0xFF byte or len if there is no
+ * such byte. Vector versions compare 16 or 32 bytes at once, the version is
+ * selected at runtime by CPU features.
+ */
+size_t
+exif_core_find_marker_scalar(const unsigned char *p, size_t len)
+{
+	for (size_t i = 0; i < len; i++)
+	{
+		if (p[i] == 0xFF)
+			return i;
+	}
+	return len;
+}
+
+#ifdef EXIF_CORE_X86_SIMD
+__attribute__((target("sse2")))
+static size_t
+exif_find_marker_sse2(const unsigned char *p, size_t len)
+{
+	const __m128i	ff = _mm_set1_epi8((char) 0xFF);
+	size_t			i = 0;
+
+	for (; i + 16 <= len; i += 16)
+	{
+		__m128i		v = _mm_loadu_si128((const __m128i *) (p + i));
+		int			mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, ff));
+
+		if (mask != 0)
+			return i + __builtin_ctz(mask);
+	}
+	return i + exif_core_find_marker_scalar(p + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static size_t
+exif_find_marker_avx2(const unsigned char *p, size_t len)
+{
+	const __m256i	ff = _mm256_set1_epi8((char) 0xFF);
+	size_t			i = 0;
+
+	for (; i + 32 <= len; i += 32)
+	{
+		__m256i		v = _mm256_loadu_si256((const __m256i *) (p + i));
+		unsigned	mask = (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, ff));
+
+		if (mask != 0)
+			return i + __builtin_ctz(mask);
+	}
+	return i + exif_find_marker_sse2(p + i, len - i);
+}
+#endif
+
+size_t
+exif_core_find_marker(const unsigned char *p, size_t len)
+{
+#ifdef EXIF_CORE_X86_SIMD
+	if (__builtin_cpu_supports("avx2"))
+		return exif_find_marker_avx2(p, len);
+	if (__builtin_cpu_supports("sse2"))
+		return exif_find_marker_sse2(p, len);
+#endif
+	return exif_core_find_marker_scalar(p, len);
+}
+
+const char *
+exif_core_simd_name(void)
+{
+#ifdef EXIF_CORE_X86_SIMD
+	if (__builtin_cpu_supports("avx2"))
+		return "avx2";
+	if (__builtin_cpu_supports("sse2"))
+		return "sse2";
+#endif
+	return "scalar";
+}
+
+/*
+ * exif_jpeg_is_marker
+ * Checks a marker found after garbage. Only SOS, EOI or a marker code of a
+ * segment with length which fits the data are accepted, hence stuffed
+ * 0xFF 0x00 bytes, fill bytes, RSTn, SOI and reserved codes are garbage.
+ */
+static bool
+exif_jpeg_is_marker(ExifCoreSource *src, int64_t off)
+{
+	const unsigned char *p = FETCH(src, off, 4);
+	uint8_t		marker;
+
+	if (p == NULL)
+	{
+		/* no room for length, only the final EOI */
+		p = FETCH(src, off, 2);
+		return p != NULL && p[1] == JPEG_MARKER_EOI;
+	}
+	marker = p[1];
+	if (marker == JPEG_MARKER_SOS || marker == JPEG_MARKER_EOI)
+		return true;
+	if (marker < 0xC0 || marker == 0xFF || marker == JPEG_MARKER_SOI ||
+		(marker >= 0xD0 && marker <= 0xD7))
+		return false;
+	return ((p[2] << 8) | p[3]) >= 2 && off + 2 + ((p[2] << 8) | p[3]) <= src->size;
+}
+
+/*
+ * exif_jpeg_resync
+ * Moves *pos to the next marker after garbage between JPEG segments. 0xFF
+ * bytes are found by exif_core_find_marker and checked by
+ * exif_jpeg_is_marker.
+ */
+static bool
+exif_jpeg_resync(ExifCoreSource *src, int64_t *pos)
+{
+	int64_t		off = *pos;
+
+	while (off < src->size)
+	{
+		int32_t		len = src->size - off < EXIF_SCAN_WINDOW ? (int32_t) (src->size - off) : EXIF_SCAN_WINDOW;
+		const unsigned char *p = FETCH(src, off, len);
+		size_t		i;
+
+		if (p == NULL)
+			return false;
+		i = exif_core_find_marker(p, len);
+		if (i == (size_t) len)
+		{
+			off += len;
+			continue;
+		}
+		off += i;
+		if (exif_jpeg_is_marker(src, off))
+		{
+			*pos = off;
+			return true;
+		}
+		off++;
+	}
+	return false;
+}
+
+/*
+ * exif_core_jpeg_next_segment
+ * Reads JPEG marker segment header at *pos and moves *pos to the next segment.
+ * Returns 0 at the end of the header part of JPEG data (SOS or EOI marker)
+ * or for corrupted data. *pos must be 2 (after SOI marker) for first call.
+ * Garbage bytes between segments are skipped up to the next marker.
+ */
+int
+exif_core_jpeg_next_segment(ExifCoreSource *src, int64_t *pos, ExifJpegSegment *seg)
+{
+	const unsigned char *p;
+
+	for (;;)
+	{
+		uint8_t		marker;
+
+		p = FETCH(src, *pos, 2);
+		if (p == NULL)
+			return 0;
+		if (p[0] != 0xFF)
+		{
+			if (!exif_jpeg_resync(src, pos))
+				return 0;
+			continue;
+		}
+		marker = p[1];
+		if (marker == 0xFF) /* fill byte */
+		{
+			(*pos)++;
+			continue;
+		}
+		if (marker == JPEG_MARKER_SOS || marker == JPEG_MARKER_EOI)
+			return 0;
+		if (marker == JPEG_MARKER_SOI || marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+		{
+			/* standalone marker without length */
+			*pos += 2;
+			continue;
+		}
+
+		p = FETCH(src, *pos + 2, 2);
+		if (p == NULL)
+			return 0;
+		seg->marker = marker;
+		seg->length = ((p[0] << 8) | p[1]) - 2;
+		seg->offset = *pos + 4;
+		if (seg->length < 0 || seg->offset + seg->length > src->size)
+			return 0;
+		*pos = seg->offset + seg->length;
+		return 1;
+	}
+}
+
+/*
+ * exif_core_jpeg_segment
+ * Returns segment number i of the source in *seg. The segment table of the
+ * source is extended only up to the requested segment, hence a lookup of
+ * first segments doesn't walk all of JPEG header part, and next lookups
+ * continue the walk. Returns 0 if there is no such segment.
+ */
+int
+exif_core_jpeg_segment(ExifCoreSource *src, int i, ExifJpegSegment *seg)
+{
+	ExifJpegSegments   *t = src->segments;
+
+	if (t->next == 0)
+		t->next = 2;
+	while (i >= t->count)
+	{
+		if (t->done || !exif_core_jpeg_next_segment(src, &t->next, seg))
+		{
+			t->done = 1;
+			return 0;
+		}
+		if (t->count == t->cap)
+		{
+			int			cap = t->cap ? t->cap * 2 : 16;
+			void	   *segs = t->grow ? t->grow(t->segs, cap * sizeof(ExifJpegSegment))
+									   : realloc(t->segs, cap * sizeof(ExifJpegSegment));
+
+			if (segs == NULL)
+			{
+				t->done = 1;
+				return 0;
+			}
+			t->segs = segs;
+			t->cap = cap;
+		}
+		t->segs[t->count++] = *seg;
+	}
+	*seg = t->segs[i];
+	return 1;
+}
+
+/*
+ * exif_core_is_jpeg
+ * Checks SOI marker at the begin of the data.
+ */
+int
+exif_core_is_jpeg(ExifCoreSource *src)
+{
+	const unsigned char *p = FETCH(src, 0, 2);
+
+	return p != NULL && p[0] == 0xFF && p[1] == JPEG_MARKER_SOI;
+}
+
+/*
+ * exif_block_copy
+ * Returns a copy of EXIF block from TIFF header or "Exif\0\0" header at off.
+ * "Exif\0\0" header is added if there is no such header before TIFF data.
+ */
+static unsigned char *
+exif_block_copy(ExifCoreSource *src, int64_t off, int64_t len, unsigned int *size)
+{
+	const unsigned char *p;
+	unsigned char	   *res;
+	bool				has_header;
+
+	if (len <= 0 || len > EXIF_MAX_BLOCK_LEN)
+		return NULL;
+	p = FETCH(src, off, (int32_t) len);
+	if (p == NULL)
+		return NULL;
+
+	has_header = len >= EXIF_HEADER_LEN && memcmp(p, ExifHeader, EXIF_HEADER_LEN) == 0;
+	*size = has_header ? len : len + EXIF_HEADER_LEN;
+	res = malloc(*size);
+	if (res == NULL)
+		return NULL;
+	if (has_header)
+		memcpy(res, p, len);
+	else
+	{
+		memcpy(res, ExifHeader, EXIF_HEADER_LEN);
+		memcpy(res + EXIF_HEADER_LEN, p, len);
+	}
+	return res;
+}
+
+/*
+ * exif_locate_jpeg
+ * EXIF data is in the first APP1 segment with "Exif\0\0" header. Segments
+ * after this segment are not read.
+ */
+static unsigned char *
+exif_locate_jpeg(ExifCoreSource *src, unsigned int *size)
+{
+	ExifJpegSegment		seg;
+	int64_t				pos = 2;
+
+	/* the segment table if there is one, otherwise walk the data */
+	for (int i = 0; src->segments != NULL ? exif_core_jpeg_segment(src, i, &seg)
+										  : exif_core_jpeg_next_segment(src, &pos, &seg); i++)
+	{
+		const unsigned char *p;
+
+		if (seg.marker != JPEG_MARKER_APP1 || seg.length < EXIF_HEADER_LEN)
+			continue;
+		p = FETCH(src, seg.offset, EXIF_HEADER_LEN);
+		if (p != NULL && memcmp(p, ExifHeader, EXIF_HEADER_LEN) == 0)
+			return exif_block_copy(src, seg.offset, seg.length, size);
+	}
+	return NULL;
+}
+
+/*
+ * exif_locate_png
+ * EXIF data is TIFF data of eXIf chunk. Chunks: length, type, data, CRC.
+ */
+static unsigned char *
+exif_locate_png(ExifCoreSource *src, unsigned int *size)
+{
+	int64_t	pos = sizeof(PngSignature);
+
+	for (;;)
+	{
+		const unsigned char *p = FETCH(src, pos, 8);
+		uint32_t			 len;
+
+		if (p == NULL)
+			return NULL;
+		len = exif_get_be32(p);
+		if (memcmp(p + 4, "eXIf", 4) == 0)
+			return exif_block_copy(src, pos + 8, len, size);
+		if (memcmp(p + 4, "IEND", 4) == 0)
+			return NULL;
+		pos += 8 + (int64_t) len + 4;
+	}
+}
+
+/*
+ * exif_locate_webp
+ * EXIF data is in RIFF EXIF chunk. Chunks: FourCC, little endian length,
+ * data padded to even length.
+ */
+static unsigned char *
+exif_locate_webp(ExifCoreSource *src, unsigned int *size)
+{
+	int64_t	pos = 12;
+
+	for (;;)
+	{
+		const unsigned char *p = FETCH(src, pos, 8);
+		uint32_t			 len;
+
+		if (p == NULL)
+			return NULL;
+		len = exif_get_le32(p + 4);
+		if (memcmp(p, "EXIF", 4) == 0)
+			return exif_block_copy(src, pos + 8, len, size);
+		pos += 8 + (int64_t) len + (len & 1);
+	}
+}
+
+/*
+ * ISO base media file format box header at pos.
+ * Returns false for invalid box or for end of parent box.
+ */
+static bool
+isobmff_box(ExifCoreSource *src, int64_t pos, int64_t end, char *type, int64_t *payload, int64_t *box_end)
+{
+	const unsigned char *p;
+	uint64_t			 box_size;
+
+	if (pos + 8 > end)
+		return false;
+	p = FETCH(src, pos, 8);
+	if (p == NULL)
+		return false;
+	box_size = exif_get_be32(p);
+	memcpy(type, p + 4, 4);
+	*payload = pos + 8;
+	if (box_size == 1)
+	{
+		/* 64 bit largesize */
+		p = FETCH(src, pos + 8, 8);
+		if (p == NULL)
+			return false;
+		box_size = exif_get_be(p, 8);
+		*payload = pos + 16;
+	}
+	else if (box_size == 0)
+		box_size = end - pos; /* box to the end of parent */
+
+	if (box_size < (uint64_t) (*payload - pos) || box_size > (uint64_t) (end - pos))
+		return false;
+	*box_end = pos + box_size;
+	return true;
+}
+
+static bool
+isobmff_is_heif(ExifCoreSource *src)
+{
+	static const char *const brands[] = {
+		"heic", "heix", "heim", "heis", "hevc", "hevx", "hevm", "hevs",
+		"mif1", "msf1", "avif", "avis", NULL
+	};
+	const unsigned char *p = FETCH(src, 0, 12);
+	int64_t				 len;
+
+	if (p == NULL || memcmp(p + 4, "ftyp", 4) != 0)
+		return false;
+	len = exif_get_be32(p);
+	if (len < 16 || len > 4096)
+		return false;
+	p = FETCH(src, 8, (int32_t) len - 8);
+	if (p == NULL)
+		return false;
+	/* major brand, minor version, compatible brands */
+	for (int64_t i = 0; i + 4 <= len - 8; i += 4)
+	{
+		if (i == 4)
+			continue;
+		for (int j = 0; brands[j]; j++)
+		{
+			if (memcmp(p + i, brands[j], 4) == 0)
+				return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * isobmff_exif_item
+ * Finds item ID of 'Exif' item in iinf box.
+ */
+static bool
+isobmff_exif_item(ExifCoreSource *src, int64_t off, int64_t end, uint32_t *item_id)
+{
+	const unsigned char *p = FETCH(src, off, 4);
+	uint8_t				 version;
+	int64_t				 pos;
+	char				 type[4];
+	int64_t				 payload;
+	int64_t				 box_end;
+
+	if (p == NULL)
+		return false;
+	version = p[0];
+	pos = off + 4 + (version == 0 ? 2 : 4);
+
+	while (isobmff_box(src, pos, end, type, &payload, &box_end))
+	{
+		if (memcmp(type, "infe", 4) == 0)
+		{
+			uint8_t	infe_version;
+			int		id_len;
+
+			p = FETCH(src, payload, 4);
+			if (p == NULL)
+				return false;
+			infe_version = p[0];
+			if (infe_version >= 2)
+			{
+				/* item ID, item protection index, item type */
+				id_len = infe_version == 2 ? 2 : 4;
+				p = FETCH(src, payload + 4, id_len + 2 + 4);
+				if (p == NULL)
+					return false;
+				if (memcmp(p + id_len + 2, "Exif", 4) == 0)
+				{
+					*item_id = (uint32_t) exif_get_be(p, id_len);
+					return true;
+				}
+			}
+		}
+		pos = box_end;
+	}
+	return false;
+}
+
+/*
+ * isobmff_exif_copy
+ * Finds extents of an item in iloc box and returns a copy of EXIF block.
+ * Exif item data: big endian offset of TIFF header, then "Exif\0\0" and TIFF.
+ */
+static unsigned char *
+isobmff_exif_copy(ExifCoreSource *src, int64_t off, int64_t end, int64_t idat, uint32_t item_id, unsigned int *size)
+{
+	const unsigned char *p;
+	unsigned char	   *iloc;
+	int64_t				len = end - off;
+	const unsigned char *c;
+	const unsigned char *iloc_end;
+	uint8_t				version;
+	int					offset_size, length_size, base_offset_size, index_size;
+	uint32_t			item_count;
+	unsigned char	   *item = NULL;
+	int64_t				item_len = 0;
+	unsigned char	   *res = NULL;
+
+	if (len < 8 || len > EXIF_MAX_BLOCK_LEN)
+		return NULL;
+	p = FETCH(src, off, (int32_t) len);
+	if (p == NULL)
+		return NULL;
+	iloc = malloc(len);
+	if (iloc == NULL)
+		return NULL;
+	memcpy(iloc, p, len);
+	iloc_end = iloc + len;
+
+#define ILOC_NEED(n)	if (c + (n) > iloc_end) goto done
+	c = iloc;
+	version = c[0];
+	offset_size = c[4] >> 4;
+	length_size = c[4] & 0x0F;
+	base_offset_size = c[5] >> 4;
+	index_size = (version == 1 || version == 2) ? (c[5] & 0x0F) : 0;
+	c += 6;
+	ILOC_NEED(version < 2 ? 2 : 4);
+	item_count = (uint32_t) exif_get_be(c, version < 2 ? 2 : 4);
+	c += version < 2 ? 2 : 4;
+
+	for (uint32_t i = 0; i < item_count; i++)
+	{
+		uint32_t	id;
+		int			construction_method = 0;
+		uint64_t	base_offset;
+		uint16_t	extent_count;
+
+		ILOC_NEED(version < 2 ? 2 : 4);
+		id = (uint32_t) exif_get_be(c, version < 2 ? 2 : 4);
+		c += version < 2 ? 2 : 4;
+		if (version == 1 || version == 2)
+		{
+			ILOC_NEED(2);
+			construction_method = c[1] & 0x0F;
+			c += 2;
+		}
+		ILOC_NEED(2 + base_offset_size + 2);
+		c += 2; /* data reference index */
+		base_offset = exif_get_be(c, base_offset_size);
+		c += base_offset_size;
+		extent_count = (uint16_t) exif_get_be(c, 2);
+		c += 2;
+
+		for (uint16_t k = 0; k < extent_count; k++)
+		{
+			uint64_t	extent_offset;
+			uint64_t	extent_length;
+			int64_t		from;
+			unsigned char *grown;
+
+			ILOC_NEED(index_size + offset_size + length_size);
+			c += index_size;
+			extent_offset = exif_get_be(c, offset_size);
+			c += offset_size;
+			extent_length = exif_get_be(c, length_size);
+			c += length_size;
+
+			if (id != item_id)
+				continue;
+			/* only file offsets and idat offsets are supported */
+			if (construction_method == 0)
+				from = base_offset + extent_offset;
+			else if (construction_method == 1 && idat >= 0)
+				from = idat + base_offset + extent_offset;
+			else
+				goto done;
+			if (extent_length == 0)
+				extent_length = src->size - from;
+			if (extent_length > (uint64_t) (EXIF_MAX_BLOCK_LEN - item_len))
+				goto done;
+			p = FETCH(src, from, (int32_t) extent_length);
+			if (p == NULL)
+				goto done;
+			grown = realloc(item, item_len + extent_length);
+			if (grown == NULL)
+				goto done;
+			item = grown;
+			memcpy(item + item_len, p, extent_length);
+			item_len += extent_length;
+		}
+		if (id == item_id)
+			break;
+	}
+
+	if (item_len > 4)
+	{
+		uint32_t	tiff_offset = exif_get_be32(item);
+		int64_t		tiff = 4 + (int64_t) tiff_offset;
+
+		if (tiff < item_len)
+		{
+			*size = item_len - tiff + EXIF_HEADER_LEN;
+			res = malloc(*size);
+			if (res != NULL)
+			{
+				memcpy(res, ExifHeader, EXIF_HEADER_LEN);
+				memcpy(res + EXIF_HEADER_LEN, item + tiff, item_len - tiff);
+			}
+		}
+	}
+done:
+#undef ILOC_NEED
+	free(item);
+	free(iloc);
+	return res;
+}
+
+/*
+ * exif_locate_heif
+ * EXIF data is an item of 'Exif' type in the meta box of HEIF or AVIF data.
+ * Item type is in 'iinf' box, item location is in 'iloc' box.
+ */
+static unsigned char *
+exif_locate_heif(ExifCoreSource *src, unsigned int *size)
+{
+	char	type[4] = {0, 0, 0, 0};
+	int64_t	payload;
+	int64_t	box_end;
+	int64_t	pos = 0;
+	int64_t	iinf = -1, iinf_end = 0;
+	int64_t	iloc = -1, iloc_end = 0;
+	int64_t	idat = -1;
+	uint32_t item_id;
+
+	/* top level boxes */
+	while (isobmff_box(src, pos, src->size, type, &payload, &box_end))
+	{
+		if (memcmp(type, "meta", 4) == 0)
+			break;
+		pos = box_end;
+	}
+	if (memcmp(type, "meta", 4) != 0)
+		return NULL;
+
+	/* meta is a full box: version and flags */
+	pos = payload + 4;
+	{
+		int64_t	meta_end = box_end;
+
+		while (isobmff_box(src, pos, meta_end, type, &payload, &box_end))
+		{
+			if (memcmp(type, "iinf", 4) == 0)
+			{
+				iinf = payload;
+				iinf_end = box_end;
+			}
+			else if (memcmp(type, "iloc", 4) == 0)
+			{
+				iloc = payload;
+				iloc_end = box_end;
+			}
+			else if (memcmp(type, "idat", 4) == 0)
+				idat = payload;
+			pos = box_end;
+		}
+	}
+
+	if (iinf < 0 || iloc < 0)
+		return NULL;
+	if (!isobmff_exif_item(src, iinf, iinf_end, &item_id))
+		return NULL;
+	return isobmff_exif_copy(src, iloc, iloc_end, idat, item_id, size);
+}
+
+/*
+ * exif_core_locate
+ * Locates EXIF block in JPEG, PNG, WebP or HEIF/AVIF data. Returns a malloc'ed
+ * copy of the block with "Exif\0\0" header or NULL. *container is
+ * EXIF_CONTAINER_OTHER for data of not known container format.
+ */
+unsigned char *
+exif_core_locate(ExifCoreSource *src, unsigned int *size, ExifCoreContainer *container)
+{
+	const unsigned char *p;
+
+	*container = EXIF_CONTAINER_NONE;
+	if (src->size == 0) /* no data */
+		return NULL;
+
+	if (exif_core_is_jpeg(src))
+	{
+		*container = EXIF_CONTAINER_JPEG;
+		return exif_locate_jpeg(src, size);
+	}
+	p = FETCH(src, 0, src->size < 16 ? (int32_t) src->size : 16);
+	if (p == NULL)
+		return NULL;
+	if (src->size >= sizeof(PngSignature) && memcmp(p, PngSignature, sizeof(PngSignature)) == 0)
+	{
+		*container = EXIF_CONTAINER_PNG;
+		return exif_locate_png(src, size);
+	}
+	if (src->size >= 12 && memcmp(p, "RIFF", 4) == 0 && memcmp(p + 8, "WEBP", 4) == 0)
+	{
+		*container = EXIF_CONTAINER_WEBP;
+		return exif_locate_webp(src, size);
+	}
+	if (src->size >= 12 && memcmp(p + 4, "ftyp", 4) == 0)
+	{
+		if (!isobmff_is_heif(src))
+			return NULL;
+		*container = EXIF_CONTAINER_HEIF;
+		return exif_locate_heif(src, size);
+	}
+	/* raw EXIF data or other formats of libexif loader */
+	*container = EXIF_CONTAINER_OTHER;
+	return NULL;
+}
+
+/* TIFF data reads in byte order of the data */
+static uint32_t
+tiff_get(const unsigned char *p, int n, bool le)
+{
+	uint32_t	v = 0;
+
+	for (int i = 0; i < n; i++)
+		v |= (uint32_t) p[i] << (8 * (le ? i : n - 1 - i));
+	return v;
+}
+
+/*
+ * tiff_ifd_find
+ * Returns offset of 12 byte IFD entry with the tag or 0.
+ */
+static uint32_t
+tiff_ifd_find(const unsigned char *tiff, uint32_t size, uint32_t ifd, uint16_t tag, bool le)
+{
+	uint32_t	n;
+
+	if (ifd < 8 || (uint64_t) ifd + 2 > size)
+		return 0;
+	n = tiff_get(tiff + ifd, 2, le);
+	for (uint32_t i = 0; i < n; i++)
+	{
+		uint32_t	e = ifd + 2 + i * 12;
+
+		if ((uint64_t) e + 12 > size)
+			return 0;
+		if (tiff_get(tiff + e, 2, le) == tag)
+			return e;
+	}
+	return 0;
+}
+
+/*
+ * exif_makernote_entry
+ * Finds MakerNote entry of EXIF IFD in EXIF block with "Exif\0\0" header.
+ * Returns offset of the entry in TIFF data or 0 and sets offset of the IFD.
+ */
+static uint32_t
+exif_makernote_entry(const unsigned char *block, unsigned int size, uint32_t *ifd, bool *le)
+{
+	const unsigned char *tiff = block + EXIF_HEADER_LEN;
+	uint32_t	tsize;
+	uint32_t	e;
+
+	if (size < EXIF_HEADER_LEN + 8 || memcmp(block, ExifHeader, EXIF_HEADER_LEN) != 0)
+		return 0;
+	tsize = size - EXIF_HEADER_LEN;
+	if (memcmp(tiff, "II", 2) == 0)
+		*le = true;
+	else if (memcmp(tiff, "MM", 2) == 0)
+		*le = false;
+	else
+		return 0;
+
+	e = tiff_ifd_find(tiff, tsize, tiff_get(tiff + 4, 4, *le), EXIF_TAG_EXIF_IFD_POINTER, *le);
+	if (e == 0)
+		return 0;
+	*ifd = tiff_get(tiff + e + 8, 4, *le);
+	return tiff_ifd_find(tiff, tsize, *ifd, EXIF_TAG_MAKER_NOTE, *le);
+}
+
+/*
+ * exif_makernote_restore
+ * Adds not interpreted MakerNote entry to EXIF IFD as it is in TIFF data.
+ * libexif keeps entries in order of TIFF data and appends fixed entries,
+ * so the entry is placed before the first entry which is not before it in
+ * the TIFF IFD, hence the order of tags is the same as after loading with
+ * MakerNote.
+ */
+static void
+exif_makernote_restore(ExifData *edata, const unsigned char *tiff, uint32_t tsize, uint32_t ifd, uint32_t e, bool le)
+{
+	ExifContent *content = edata->ifd[EXIF_IFD_EXIF];
+	ExifFormat	format = (ExifFormat) tiff_get(tiff + e + 2, 2, le);
+	uint32_t	components = tiff_get(tiff + e + 4, 4, le);
+	uint64_t	len = (uint64_t) exif_format_get_size(format) * components;
+	uint32_t	off = len > 4 ? tiff_get(tiff + e + 8, 4, le) : e + 8;
+	unsigned int pos;
+	ExifEntry  *ee;
+
+	if (content == NULL || len == 0 || off + len > tsize)
+		return;
+	ee = exif_entry_new ();
+	if (ee == NULL)
+		return;
+	ee->data = malloc(len);
+	if (ee->data == NULL)
+	{
+		exif_entry_unref (ee);
+		return;
+	}
+	memcpy(ee->data, tiff + off, len);
+	ee->tag = EXIF_TAG_MAKER_NOTE;
+	ee->format = format;
+	ee->components = components;
+	ee->size = len;
+	exif_content_add_entry (content, ee);
+	exif_entry_unref (ee);
+	if (content->count == 0 || content->entries[content->count - 1] != ee)
+		return;
+
+	for (pos = 0; pos < content->count - 1; pos++)
+	{
+		bool		before = false;
+
+		for (uint32_t f = ifd + 2; f < e && !before; f += 12)
+			before = tiff_get(tiff + f, 2, le) == content->entries[pos]->tag;
+		if (!before)
+			break;
+	}
+	memmove(content->entries + pos + 1, content->entries + pos,
+			(content->count - 1 - pos) * sizeof(ExifEntry *));
+	content->entries[pos] = ee;
+}
+
+/*
+ * exif_data_load_block
+ * Loads EXIF block with "Exif\0\0" header. libexif always interprets
+ * MakerNote while loading and has no option to skip it. If makernote is 0,
+ * libexif gets the block with zero component count of MakerNote entry, hence
+ * the entry is skipped, and the entry is added after loading as not
+ * interpreted data. exif_data_get_mnote_data returns NULL for such data.
+ * A private block (writable) is changed in place and restored after
+ * loading, other blocks are copied.
+ */
+static ExifData *
+exif_data_load_block(const unsigned char *block, unsigned int size, int makernote, bool writable)
+{
+	ExifData	   *edata = exif_data_new ();
+	unsigned char  *load;
+	unsigned char	count[4];
+	uint32_t		e = 0;
+	uint32_t		ifd = 0;
+	bool			le = false;
+
+	if (edata == NULL)
+		return NULL;
+	if (!makernote)
+		e = exif_makernote_entry(block, size, &ifd, &le);
+	if (e == 0)
+	{
+		exif_data_load_data (edata, block, size);
+		return edata;
+	}
+
+	if (writable)
+		load = (unsigned char *) block;
+	else
+	{
+		load = malloc(size);
+		if (load == NULL)
+		{
+			exif_data_unref (edata);
+			return NULL;
+		}
+		memcpy(load, block, size);
+	}
+	memcpy(count, load + EXIF_HEADER_LEN + e + 4, 4);
+	memset(load + EXIF_HEADER_LEN + e + 4, 0, 4);
+	exif_data_load_data (edata, load, size);
+	if (writable)
+		memcpy(load + EXIF_HEADER_LEN + e + 4, count, 4);
+	else
+		free(load);
+	exif_makernote_restore(edata, block + EXIF_HEADER_LEN, size - EXIF_HEADER_LEN, ifd, e, le);
+	return edata;
+}
+
+/*
+ * exif_core_data_new
+ * Loads EXIF block with "Exif\0\0" header, see exif_data_load_block. The
+ * block is not changed.
+ */
+ExifData *
+exif_core_data_new(const unsigned char *block, unsigned int size, int makernote)
+{
+	return exif_data_load_block(block, size, makernote, false);
+}
+
+/*
+ * exif_core_loader
+ * Gives whole data to libexif loader, used for not known containers.
+ */
+ExifData *
+exif_core_loader(const unsigned char *data, size_t size, int makernote)
+{
+	ExifLoader			*loader = exif_loader_new ();
+	const unsigned char *buf = NULL;
+	unsigned int		 buf_size = 0;
+	ExifData			*edata = NULL;
+
+	if (loader == NULL)
+		return NULL;
+	/* the loader copies the data, it is not changed */
+	exif_loader_write (loader, (unsigned char *) data, size);
+	exif_loader_get_buf (loader, &buf, &buf_size);
+	/* the buffer belongs to the loader until exif_loader_unref */
+	if (buf != NULL && buf_size > 0)
+		edata = exif_core_data_new(buf, buf_size, makernote);
+	exif_loader_unref (loader);
+	return edata;
+}
+
+/*
+ * exif_core_data_from_source
+ * Container aware front end for libexif. Returns NULL if there is no EXIF
+ * data structure or for EXIF_CONTAINER_OTHER *container, when the caller
+ * must use exif_core_loader for whole data.
+ */
+ExifData *
+exif_core_data_from_source(ExifCoreSource *src, ExifCoreContainer *container, int makernote)
+{
+	unsigned int	size = 0;
+	unsigned char  *block = exif_core_locate(src, &size, container);
+	ExifData	   *edata;
+
+	if (block == NULL) /* no EXIF data structure */
+		return NULL;
+	/* the block is a private copy of the data */
+	edata = exif_data_load_block(block, size, makernote, true);
+	free(block);
+	return edata;
+}
+
+/*
+ * XXH64 hash, see https://github.com/Cyan4973/xxHash. Little endian reads
+ * give the same values on all platforms.
+ */
+#define XXH_PRIME64_1	UINT64_C(11400714785074694791)
+#define XXH_PRIME64_2	UINT64_C(14029467366897019727)
+#define XXH_PRIME64_3	UINT64_C(1609587929392839161)
+#define XXH_PRIME64_4	UINT64_C(9650029242287828579)
+#define XXH_PRIME64_5	UINT64_C(2870177450012600261)
+#define XXH_ROTL64(x, r)	(((x) << (r)) | ((x) >> (64 - (r))))
+
+static uint64_t
+exif_get_le64(const unsigned char *p)
+{
+	return (uint64_t) exif_get_le32(p) | ((uint64_t) exif_get_le32(p + 4) << 32);
+}
+
+static uint64_t
+xxh64_round(uint64_t acc, uint64_t input)
+{
+	acc += input * XXH_PRIME64_2;
+	acc = XXH_ROTL64(acc, 31);
+	return acc * XXH_PRIME64_1;
+}
+
+static uint64_t
+xxh64_merge(uint64_t acc, uint64_t val)
+{
+	acc ^= xxh64_round(0, val);
+	return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+uint64_t
+exif_core_hash64(const unsigned char *data, size_t len, uint64_t seed)
+{
+	const unsigned char *p = data;
+	const unsigned char *end = data + len;
+	uint64_t			 h;
+
+	if (len >= 32)
+	{
+		uint64_t	v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+		uint64_t	v2 = seed + XXH_PRIME64_2;
+		uint64_t	v3 = seed;
+		uint64_t	v4 = seed - XXH_PRIME64_1;
+
+		do
+		{
+			v1 = xxh64_round(v1, exif_get_le64(p));
+			v2 = xxh64_round(v2, exif_get_le64(p + 8));
+			v3 = xxh64_round(v3, exif_get_le64(p + 16));
+			v4 = xxh64_round(v4, exif_get_le64(p + 24));
+			p += 32;
+		} while (p + 32 <= end);
+
+		h = XXH_ROTL64(v1, 1) + XXH_ROTL64(v2, 7) + XXH_ROTL64(v3, 12) + XXH_ROTL64(v4, 18);
+		h = xxh64_merge(h, v1);
+		h = xxh64_merge(h, v2);
+		h = xxh64_merge(h, v3);
+		h = xxh64_merge(h, v4);
+	}
+	else
+		h = seed + XXH_PRIME64_5;
+
+	h += (uint64_t) len;
+	for (; p + 8 <= end; p += 8)
+	{
+		h ^= xxh64_round(0, exif_get_le64(p));
+		h = XXH_ROTL64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+	}
+	if (p + 4 <= end)
+	{
+		h ^= (uint64_t) exif_get_le32(p) * XXH_PRIME64_1;
+		h = XXH_ROTL64(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+		p += 4;
+	}
+	for (; p < end; p++)
+	{
+		h ^= (uint64_t) *p * XXH_PRIME64_5;
+		h = XXH_ROTL64(h, 11) * XXH_PRIME64_1;
+	}
+
+	h ^= h >> 33;
+	h *= XXH_PRIME64_2;
+	h ^= h >> 29;
+	h *= XXH_PRIME64_3;
+	h ^= h >> 32;
+	return h;
+}
+
+/*
+ * exif_core_fingerprint
+ * Hash of TIFF payload of EXIF block, the same for the same EXIF data in all
+ * of supported containers. Only container headers and EXIF block are read.
+ * Returns 0 if there is no EXIF block.
+ */
+int
+exif_core_fingerprint(ExifCoreSource *src, uint64_t *hash)
+{
+	unsigned int		size = 0;
+	ExifCoreContainer	container;
+	unsigned char	   *block = exif_core_locate(src, &size, &container);
+
+	if (block == NULL && container == EXIF_CONTAINER_OTHER)
+	{
+		/* raw EXIF data with "Exif\0\0" header */
+		const unsigned char *p = FETCH(src, 0, EXIF_HEADER_LEN);
+
+		if (p == NULL || memcmp(p, ExifHeader, EXIF_HEADER_LEN) != 0 ||
+			src->size > EXIF_MAX_BLOCK_LEN)
+			return 0;
+		p = FETCH(src, 0, (int32_t) src->size);
+		if (p == NULL)
+			return 0;
+		*hash = exif_core_hash64(p + EXIF_HEADER_LEN, src->size - EXIF_HEADER_LEN, 0);
+		return 1;
+	}
+	if (block == NULL)
+		return 0;
+	*hash = exif_core_hash64(block + EXIF_HEADER_LEN, size - EXIF_HEADER_LEN, 0);
+	free(block);
+	return 1;
+}
+
+/*
+ * exif_core_entry_by_name
+ * Searches EXIF entry by the tag name in all IFDs. Tag numbers of GPS IFD
+ * are the same as of other IFDs, hence names are compared per IFD.
+ */
+ExifEntry *
+exif_core_entry_by_name(ExifData *edata, const char *tagname)
+{
+	for (unsigned j = 0; j < EXIF_IFD_COUNT; j++)
+	{
+		ExifContent	   *content = edata->ifd[j];
+
+		if (!content) /* no EXIF data */
+			continue;
+
+		for (unsigned int i = 0; i < content->count; i++)
+		{
+			ExifEntry	   *ee = content->entries[i];
+			const char	   *tname = exif_tag_get_name_in_ifd(ee->tag, j);
+
+			if (tname != NULL && strcmp(tname, tagname) == 0)
+				return ee;
+		}
+	} /* ifd */
+	return NULL;
+}
+
+/*
+ * exif_core_tag_value
+ * Returns malloc'ed text value of a tag as libexif formats it or NULL.
+ */
+char *
+exif_core_tag_value(ExifData *edata, const char *tagname)
+{
+	ExifEntry  *ee = exif_core_entry_by_name(edata, tagname);
+	char		buf[EXIF_CORE_VALUE_LEN];
+
+	if (ee == NULL)
+		return NULL;
+	exif_entry_get_value(ee, buf, sizeof(buf));
+	return strdup(buf);
+}
+
+static double
+exif_gps_extract_double (ExifByteOrder o, ExifEntry * e)
+{
+	ExifRational v_rat;
+	double res = 0.0;
+
+	if (e == NULL || e->format != EXIF_FORMAT_RATIONAL)
+		return NAN;
+
+	if (e->components > 0)
+	{
+		v_rat = exif_get_rational (e->data + 8 * 0, o);
+		res += (double) v_rat.numerator / (double) v_rat.denominator;
+	}
+
+	if (e->components > 1)
+	{
+		v_rat = exif_get_rational (e->data + 8 * 1, o);
+		res += (double) v_rat.numerator / (double) v_rat.denominator / 60.0;
+	}
+
+	if (e->components > 2)
+	{
+		v_rat = exif_get_rational (e->data + 8 * 2, o);
+		res += (double) v_rat.numerator / (double) v_rat.denominator / 3600.0;
+	}
+
+	return res;
+}
+
+/*
+ * exif_core_gps_point
+ * Writes OGC point of photographer or of destination (dest != 0) location.
+ * Returns 0 if there is no necessary GPS data.
+ */
+int
+exif_core_gps_point(ExifData *edata, int dest, char *buf, size_t buflen)
+{
+	ExifContent	   *content = edata->ifd[EXIF_IFD_GPS];
+	ExifByteOrder	o = exif_data_get_byte_order (edata);
+	ExifEntry	   *e_lat;
+	ExifEntry	   *e_lat_ref;
+	ExifEntry	   *e_lon;
+	ExifEntry	   *e_lon_ref;
+	ExifEntry	   *e_geo_datum;
+	double			lat;
+	double			lon;
+	char			lat_ref;
+	char			lon_ref;
+	const char	   *srid;
+
+	if (!content) /* no EXIF data */
+		return 0;
+
+	e_lat = exif_content_get_entry (content, dest ? EXIF_TAG_GPS_DEST_LATITUDE : EXIF_TAG_GPS_LATITUDE);
+	e_lat_ref = exif_content_get_entry (content, dest ? EXIF_TAG_GPS_DEST_LATITUDE_REF : EXIF_TAG_GPS_LATITUDE_REF);
+	e_lon = exif_content_get_entry (content, dest ? EXIF_TAG_GPS_DEST_LONGITUDE : EXIF_TAG_GPS_LONGITUDE);
+	e_lon_ref = exif_content_get_entry (content, dest ? EXIF_TAG_GPS_DEST_LONGITUDE_REF : EXIF_TAG_GPS_LONGITUDE_REF);
+	e_geo_datum = exif_content_get_entry (content, EXIF_TAG_GPS_MAP_DATUM);
+
+	if (e_lon == NULL || e_lat == NULL || e_lon_ref == NULL || e_lat_ref == NULL) /* no necessary geo data */
+		return 0;
+
+	lat = exif_gps_extract_double(o, e_lat);
+	lon = exif_gps_extract_double(o, e_lon);
+	lat_ref = e_lat_ref->size ? e_lat_ref->data[0] : 0;
+	lon_ref = e_lon_ref->size ? e_lon_ref->data[0] : 0;
+	srid = (e_geo_datum == NULL) ? "" : (strncmp("WGS-84", (const char *)(e_geo_datum->data), e_geo_datum->size) == 0) ? "SRID=4326;" : "";
+
+	if ( lat_ref == 'S')
+		lat = lat * -1.0;
+	if ( lon_ref == 'W')
+		lon = lon * -1.0;
+	snprintf(buf, buflen, "%sPoint(%2.*f %2.*f)", srid, 14, lon, 14, lat);
+	return 1;
+}
+
+/*
+ * exif_core_datetime_valid
+ * Checks ranges of date and time fields.
+ */
+int
+exif_core_datetime_valid(const ExifCoreDateTime *dt)
+{
+	return !(dt->year < 1 || dt->month < 1 || dt->month > 12 ||
+			 dt->day < 1 || dt->day > day_tab[IS_LEAP(dt->year)][dt->month - 1] ||
+			 dt->hour < 0 || dt->hour >= 24 || dt->minute < 0 || dt->minute >= 60 ||
+			 dt->second < 0 || dt->second > 60 ||
+			 dt->usec < 0 || dt->usec >= 1000000 ||
+			 dt->tz <= -16 * 3600 || dt->tz >= 16 * 3600);
+}
+
+/*
+ * exif_core_gps_datetime
+ * GPS date and time, according EXIF standard the value is UTC time.
+ */
+ExifCoreStatus
+exif_core_gps_datetime(ExifData *edata, ExifCoreDateTime *dt, ExifCoreInfo *info)
+{
+	ExifContent	   *content = edata->ifd[EXIF_IFD_GPS];
+	ExifByteOrder	o = exif_data_get_byte_order (edata);
+	ExifEntry	   *e_ts;
+	ExifEntry	   *e_ds;
+	ExifRational	rh, rm, rs;
+	char			date[12];
+	double			sec;
+	int64_t			usec;
+
+	memset(dt, 0, sizeof(ExifCoreDateTime));
+	memset(info, 0, sizeof(ExifCoreInfo));
+	if (!content) /* no EXIF data */
+		return EXIF_CORE_NO_VALUE;
+
+	e_ts = exif_content_get_entry (content, EXIF_TAG_GPS_TIME_STAMP);
+	e_ds = exif_content_get_entry (content, EXIF_TAG_GPS_DATE_STAMP);
+	if (e_ts == NULL || e_ds == NULL) /* no necessary timestamp data */
+		return EXIF_CORE_NO_VALUE;
+
+	if (e_ds->format != EXIF_FORMAT_ASCII || e_ds->size != 11)
+	{
+		info->format = e_ds->format;
+		info->size = e_ds->size;
+		return EXIF_CORE_GPS_DATE_FORMAT;
+	}
+	if (e_ts->format != EXIF_FORMAT_RATIONAL || e_ts->components < 3)
+	{
+		info->format = e_ts->format;
+		info->size = e_ts->size;
+		return EXIF_CORE_GPS_TIME_FORMAT;
+	}
+
+	rh = exif_get_rational (e_ts->data, o);
+	rm = exif_get_rational (e_ts->data + exif_format_get_size (e_ts->format), o);
+	rs = exif_get_rational (e_ts->data + 2 * exif_format_get_size (e_ts->format), o);
+	info->rational[0] = rh.numerator;
+	info->rational[1] = rh.denominator;
+	info->rational[2] = rm.numerator;
+	info->rational[3] = rm.denominator;
+	info->rational[4] = rs.numerator;
+	info->rational[5] = rs.denominator;
+
+	memcpy(date, e_ds->data, 11);
+	date[11] = '\0';
+	memcpy(info->text, date, sizeof(date));
+	dt->year = (int) strtol(date + 0, NULL, 10);
+	dt->month = (int) strtol(date + 5, NULL, 10);
+	dt->day = (int) strtol(date + 8, NULL, 10);
+
+	if (rh.denominator == 0 || rm.denominator == 0 || rs.denominator == 0)
+		return EXIF_CORE_GPS_TIME_INVALID;
+
+	sec = (double) rs.numerator / (double) rs.denominator;
+	usec = (int64_t) rint(sec * 1000000.0);
+	dt->hour = rh.numerator / rh.denominator;
+	dt->minute = rm.numerator / rm.denominator;
+	dt->second = (int) (usec / 1000000);
+	dt->usec = (int32_t) (usec % 1000000);
+	if (sec < 0 || sec > 60 || !exif_core_datetime_valid(dt))
+		return EXIF_CORE_GPS_RANGE;
+	return EXIF_CORE_OK;
+}
+
+/*
+ * exif_entry_ascii
+ * Copies ASCII EXIF value to a null terminated buffer.
+ */
+static bool
+exif_entry_ascii(ExifEntry *e, char *buf, unsigned buflen)
+{
+	unsigned	n;
+
+	if (e == NULL || e->format != EXIF_FORMAT_ASCII || e->data == NULL)
+		return false;
+	n = e->size < buflen - 1 ? e->size : buflen - 1;
+	memcpy(buf, e->data, n);
+	buf[n] = '\0';
+	return true;
+}
+
+/*
+ * exif_core_datetime
+ * DateTime, DateTimeOriginal or DateTimeDigitized EXIF value. OffsetTime* and
+ * SubSecTime* tags of the same kind are used as time zone offset and fraction
+ * of second. Local time without offset tag or with use_offset = 0 has tz = 0.
+ * Malformed offset sets info->offset_format, the time is read as UTC then.
+ * Blank or zero values are EXIF_CORE_NO_VALUE.
+ */
+ExifCoreStatus
+exif_core_datetime(ExifData *edata, ExifTag tag_dt, int use_offset, ExifCoreDateTime *dt, ExifCoreInfo *info)
+{
+	ExifTag			tag_offset;
+	ExifTag			tag_subsec;
+	char			offset[7];
+	char			subsec[16];
+
+	memset(dt, 0, sizeof(ExifCoreDateTime));
+	memset(info, 0, sizeof(ExifCoreInfo));
+	switch (tag_dt)
+	{
+		case EXIF_TAG_DATE_TIME_ORIGINAL:
+			tag_offset = BYTEA_EXIF_TAG_OFFSET_TIME_ORIGINAL;
+			tag_subsec = EXIF_TAG_SUB_SEC_TIME_ORIGINAL;
+			break;
+		case EXIF_TAG_DATE_TIME_DIGITIZED:
+			tag_offset = BYTEA_EXIF_TAG_OFFSET_TIME_DIGITIZED;
+			tag_subsec = EXIF_TAG_SUB_SEC_TIME_DIGITIZED;
+			break;
+		default:
+			tag_dt = EXIF_TAG_DATE_TIME;
+			tag_offset = BYTEA_EXIF_TAG_OFFSET_TIME;
+			tag_subsec = EXIF_TAG_SUB_SEC_TIME;
+			break;
+	}
+
+	/* "YYYY:MM:DD HH:MM:SS" */
+	if (!exif_entry_ascii(exif_data_get_entry (edata, tag_dt), info->text, 20))
+		return EXIF_CORE_NO_VALUE;
+
+	if (sscanf(info->text, "%4d:%2d:%2d %2d:%2d:%2d",
+			   &dt->year, &dt->month, &dt->day, &dt->hour, &dt->minute, &dt->second) != 6)
+	{
+		/* "    :  :     :  :  " means unknown date and time */
+		if (strspn(info->text, " :0") == strlen(info->text))
+			return EXIF_CORE_NO_VALUE;
+		return EXIF_CORE_DATETIME_FORMAT;
+	}
+	if (dt->year == 0 && dt->month == 0 && dt->day == 0) /* unknown date */
+		return EXIF_CORE_NO_VALUE;
+
+	/* "+HH:MM" or "-HH:MM", blank value means unknown offset */
+	if (use_offset &&
+		exif_entry_ascii(exif_data_get_entry (edata, tag_offset), offset, sizeof(offset)))
+	{
+		int		oh, om;
+
+		if ((offset[0] == '+' || offset[0] == '-') &&
+			sscanf(offset + 1, "%2d:%2d", &oh, &om) == 2 &&
+			oh >= 0 && oh <= 18 && om >= 0 && om < 60)
+			dt->tz = (offset[0] == '-' ? -1 : 1) * (oh * 3600 + om * 60);
+		else if (strspn(offset, " :") != strlen(offset))
+		{
+			info->offset_format = 1;
+			memcpy(info->offset, offset, sizeof(offset));
+		}
+	}
+
+	/* fraction of second as decimal digits */
+	if (exif_entry_ascii(exif_data_get_entry (edata, tag_subsec), subsec, sizeof(subsec)))
+	{
+		char   *c;
+		int		digits = 0;
+
+		for (c = subsec; *c >= '0' && *c <= '9' && digits < 6; c++, digits++)
+			dt->usec = dt->usec * 10 + (*c - '0');
+		for (; digits < 6; digits++)
+			dt->usec *= 10;
+	}
+
+	if (!exif_core_datetime_valid(dt))
+		return EXIF_CORE_DATETIME_RANGE;
+	return EXIF_CORE_OK;
+}
+
+/*
+ * exif_core_uc_utf16_name
+ * Returns iconv name of UTF-16 user comment encoding. Without byte order
+ * mark the byte order of EXIF data is used, not the byte order of the host.
+ */
+static const char *
+exif_core_uc_utf16_name(ExifData *edata, const char *text, size_t len)
+{
+	const unsigned char *p = (const unsigned char *) text;
+
+	if (len >= 2 && ((p[0] == 0xFE && p[1] == 0xFF) || (p[0] == 0xFF && p[1] == 0xFE)))
+		return "UTF-16";
+	return exif_data_get_byte_order (edata) == EXIF_BYTE_ORDER_MOTOROLA ? "UTF-16BE" : "UTF-16LE";
+}
+
+/*
+ * exif_core_user_comment
+ * Decodes UserComment EXIF tag to malloc'ed UTF-8 text. info->ascii_format
+ * is set for the tag of ASCII format, this is a problem, but the value is
+ * decoded.
+ */
+ExifCoreStatus
+exif_core_user_comment(ExifData *edata, char **utf8, ExifCoreInfo *info)
+{
+	ExifContent	   *content = edata->ifd[EXIF_IFD_EXIF];
+	ExifEntry	   *e;
+	bool			uc_ascii;
+	bool			uc_unicode;
+	bool			uc_jis;
+	bool			uc_undef;
+	char		   *user_comment_exif;
+	size_t			len_uc;
+
+	*utf8 = NULL;
+	memset(info, 0, sizeof(ExifCoreInfo));
+	if (!content) /* no EXIF data */
+		return EXIF_CORE_NO_VALUE;
+
+	e = exif_content_get_entry (content, EXIF_TAG_USER_COMMENT);
+	if (e == NULL) /* no necessary data */
+		return EXIF_CORE_NO_VALUE;
+	info->format = e->format;
+	info->size = e->size;
+
+	/*
+	 * The EXIF specification says UNDEFINED, but some
+	 * manufacturers don't care and use ASCII.
+	 */
+	if (e->format != EXIF_FORMAT_UNDEFINED && e->format != EXIF_FORMAT_ASCII)
+		return EXIF_CORE_UC_FORMAT;
+	info->ascii_format = e->format == EXIF_FORMAT_ASCII;
+
+	if (e->size <= UC_ENCODING_FIELD_SIZE)
+		return EXIF_CORE_UC_NO_TEXT;
+
+	memcpy(info->text, e->data, UC_ENCODING_FIELD_SIZE);
+	uc_ascii = 0 == memcmp (e->data, "ASCII\0\0\0"  , UC_ENCODING_FIELD_SIZE);
+	uc_unicode = 0 == memcmp (e->data, "UNICODE\0"	, UC_ENCODING_FIELD_SIZE);
+	uc_jis = 0 == memcmp (e->data, "JIS\0\0\0\0\0", UC_ENCODING_FIELD_SIZE);
+	uc_undef = 0 == memcmp (e->data, "\0\0\0\0\0\0\0\0", UC_ENCODING_FIELD_SIZE);
+
+	if (!(uc_ascii || uc_unicode || uc_jis || uc_undef))
+		return EXIF_CORE_UC_ENCODING;
+
+	len_uc = e->size - UC_ENCODING_FIELD_SIZE;
+	/*
+	 * Note that, according to the specification (V2.1, p 40),
+	 * the user comment field does not have to be
+	 * NULL terminated.
+	 */
+	user_comment_exif = malloc(len_uc + 1);
+	if (user_comment_exif == NULL)
+		return EXIF_CORE_NO_MEMORY;
+	memcpy(user_comment_exif, (char *) (e->data + UC_ENCODING_FIELD_SIZE), len_uc);
+	user_comment_exif[len_uc] = '\0';
+
+	if (uc_ascii || uc_undef)
+	{
+		*utf8 = user_comment_exif;
+		return EXIF_CORE_OK;
+	}
+	else
+	{
+		char	   *input_ptr = user_comment_exif;
+		size_t		input_bytes = len_uc;
+		size_t		output_bytes = input_bytes * 2 + 1; /* maximum to UTF-8 */
+		char	   *output = malloc(output_bytes);
+		char	   *output_ptr = output;
+		iconv_t		conv_desc;
+
+		if (output == NULL)
+		{
+			free(user_comment_exif);
+			return EXIF_CORE_NO_MEMORY;
+		}
+		if (uc_unicode)
+			conv_desc = iconv_open ("UTF-8", exif_core_uc_utf16_name(edata, user_comment_exif, len_uc));
+		else if (memchr(user_comment_exif, 0x1B, len_uc) != NULL)
+			/* JIS with escape sequences */
+			conv_desc = iconv_open ("UTF-8", "ISO-2022-JP");
+		else
+		{
+			/* plain JIS X 0208 codes, the same as EUC-JP with high bits */
+			for (size_t i = 0; i < len_uc; i++)
+			{
+				unsigned char c = (unsigned char) user_comment_exif[i];
+
+				if (c >= 0x21 && c <= 0x7E)
+					user_comment_exif[i] = (char) (c | 0x80);
+			}
+			conv_desc = iconv_open ("UTF-8", "EUC-JP");
+		}
+		if (conv_desc == (iconv_t) -1)
+		{
+			free(user_comment_exif);
+			free(output);
+			return EXIF_CORE_UC_ICONV_OPEN;
+		}
+		if (iconv(conv_desc, &input_ptr, &input_bytes, &output_ptr, &output_bytes) == (size_t) -1)
+		{
+			iconv_close(conv_desc);
+			free(user_comment_exif);
+			free(output);
+			return EXIF_CORE_UC_ICONV;
+		}
+		iconv_close(conv_desc);
+		*output_ptr = '\0';
+		free(user_comment_exif);
+		*utf8 = output;
+		return EXIF_CORE_OK;
+	}
+}
+
+/*
+ * exif_core_summary
+ * Extracts common metadata, edata can be NULL for data without EXIF.
+ */
+void
+exif_core_summary(ExifData *edata, ExifCoreSummary *s)
+{
+	char	point[128];
+
+	memset(s, 0, sizeof(ExifCoreSummary));
+	s->datetime_status = EXIF_CORE_NO_VALUE;
+	s->gps_status = EXIF_CORE_NO_VALUE;
+	s->uc_status = EXIF_CORE_NO_VALUE;
+	if (edata == NULL)
+		return;
+
+	s->has_exif = 1;
+	s->make = exif_core_tag_value(edata, "Make");
+	s->model = exif_core_tag_value(edata, "Model");
+	s->lens_model = exif_core_tag_value(edata, "LensModel");
+	s->datetime_status = exif_core_datetime(edata, EXIF_TAG_DATE_TIME_ORIGINAL, 1,
+											&s->datetime_original, &s->datetime_info);
+	s->gps_status = exif_core_gps_datetime(edata, &s->gps_utc, &s->gps_info);
+	if (exif_core_gps_point(edata, 0, point, sizeof(point)))
+		s->point = strdup(point);
+	if (exif_core_gps_point(edata, 1, point, sizeof(point)))
+		s->dest_point = strdup(point);
+	s->uc_status = exif_core_user_comment(edata, &s->user_comment, &s->uc_info);
+}
+
+void
+exif_core_summary_free(ExifCoreSummary *s)
+{
+	free(s->make);
+	free(s->model);
+	free(s->lens_model);
+	free(s->point);
+	free(s->dest_point);
+	free(s->user_comment);
+	memset(s, 0, sizeof(ExifCoreSummary));
+}
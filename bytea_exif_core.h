@@ -0,0 +1,189 @@
+/*-------------------------------------------------------------------------
+ *
+ * EXIF data extractor for PotgreSQL bytea data
+ * PostgreSQL independent core, shared by the extension and bytea_exif_extract
+ *
+ * (c) 2025, mkgrgis
+ *
+ * IDENTIFICATION
+ *		bytea_exif_core.h
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef BYTEA_EXIF_CORE_H
+#define BYTEA_EXIF_CORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-tag.h>
+
+/*
+ * No bool type in this header: it is included after c.h of PostgreSQL
+ * versions with own bool definition.
+ */
+
+/* EXIF 2.31 tags, not all of libexif versions have names for these */
+#define BYTEA_EXIF_TAG_OFFSET_TIME				((ExifTag) 0x9010)
+#define BYTEA_EXIF_TAG_OFFSET_TIME_ORIGINAL		((ExifTag) 0x9011)
+#define BYTEA_EXIF_TAG_OFFSET_TIME_DIGITIZED	((ExifTag) 0x9012)
+
+#define JPEG_MARKER_SOI	0xD8
+#define JPEG_MARKER_EOI	0xD9
+#define JPEG_MARKER_SOS	0xDA
+#define JPEG_MARKER_APP1	0xE1
+
+/* Encoding mark of UserComment */
+#define UC_ENCODING_FIELD_SIZE 8
+
+/* Buffer size for exif_entry_get_value */
+#define EXIF_CORE_VALUE_LEN	4096
+
+/* JPEG marker segment, offset and length are for payload after length field */
+typedef struct ExifJpegSegment
+{
+	uint8_t		marker;
+	int64_t		offset;
+	int32_t		length;
+} ExifJpegSegment;
+
+typedef void *(*ExifCoreRealloc) (void *ptr, size_t size);
+
+/*
+ * Table of JPEG segments before image data. The table is extended by lookups
+ * only up to the needed segment and is used by all other lookups in the same
+ * data. Zeroed table is empty.
+ */
+typedef struct ExifJpegSegments
+{
+	ExifJpegSegment	   *segs;
+	int					count;		/* segments read */
+	int					cap;
+	int64_t				next;		/* offset of next segment, 0 before first lookup */
+	int					done;		/* end of header part is reached */
+	ExifCoreRealloc		grow;		/* allocator of segs, NULL is realloc */
+} ExifJpegSegments;
+
+/*
+ * Data source for container parsing. fetch returns pointer to len bytes from
+ * offset off or NULL if the data is shorter. A pointer returned by previous
+ * call can be invalid after next call. segments is optional.
+ */
+typedef const unsigned char *(*ExifCoreFetch) (void *arg, int64_t off, int32_t len);
+
+typedef struct ExifCoreSource
+{
+	ExifCoreFetch		fetch;
+	void			   *arg;
+	int64_t				size;
+	ExifJpegSegments   *segments;
+} ExifCoreSource;
+
+typedef enum ExifCoreContainer
+{
+	EXIF_CONTAINER_NONE = 0,
+	EXIF_CONTAINER_JPEG,
+	EXIF_CONTAINER_PNG,
+	EXIF_CONTAINER_WEBP,
+	EXIF_CONTAINER_HEIF,
+	EXIF_CONTAINER_OTHER		/* whole data must be given to libexif loader */
+} ExifCoreContainer;
+
+/* Result of value extraction, not OK values are problems of EXIF data */
+typedef enum ExifCoreStatus
+{
+	EXIF_CORE_OK = 0,
+	EXIF_CORE_NO_VALUE,
+	EXIF_CORE_GPS_DATE_FORMAT,
+	EXIF_CORE_GPS_TIME_FORMAT,
+	EXIF_CORE_GPS_TIME_INVALID,
+	EXIF_CORE_GPS_RANGE,
+	EXIF_CORE_DATETIME_FORMAT,
+	EXIF_CORE_DATETIME_RANGE,
+	EXIF_CORE_UC_FORMAT,
+	EXIF_CORE_UC_NO_TEXT,
+	EXIF_CORE_UC_ENCODING,
+	EXIF_CORE_UC_ICONV_OPEN,
+	EXIF_CORE_UC_ICONV,
+	EXIF_CORE_NO_MEMORY
+} ExifCoreStatus;
+
+/* Raw EXIF values for problem reports */
+typedef struct ExifCoreInfo
+{
+	int				format;			/* EXIF format of the entry */
+	unsigned int	size;			/* size of the entry data */
+	char			text[32];		/* ASCII value or encoding mark */
+	uint32_t		rational[6];	/* GPS time as 3 rationals */
+	int				ascii_format;	/* UserComment has ASCII format */
+	int				offset_format;	/* OffsetTime* is not "+HH:MM", UTC is used */
+	char			offset[8];		/* the OffsetTime* value */
+} ExifCoreInfo;
+
+/* Date and time, tz is offset of local time in seconds east of UTC */
+typedef struct ExifCoreDateTime
+{
+	int			year;
+	int			month;
+	int			day;
+	int			hour;
+	int			minute;
+	int			second;
+	int32_t		usec;
+	int			tz;
+} ExifCoreDateTime;
+
+/*
+ * Common metadata of an image, see bytea_exif_summary SQL function.
+ * Strings are allocated by malloc, NULL means no value.
+ */
+typedef struct ExifCoreSummary
+{
+	int					has_exif;
+	char			   *make;
+	char			   *model;
+	char			   *lens_model;
+	ExifCoreStatus		datetime_status;
+	ExifCoreDateTime	datetime_original;
+	ExifCoreInfo		datetime_info;
+	ExifCoreStatus		gps_status;
+	ExifCoreDateTime	gps_utc;
+	ExifCoreInfo		gps_info;
+	char			   *point;
+	char			   *dest_point;
+	ExifCoreStatus		uc_status;
+	char			   *user_comment;
+	ExifCoreInfo		uc_info;
+} ExifCoreSummary;
+
+/* marker scanning */
+extern size_t exif_core_find_marker(const unsigned char *p, size_t len);
+extern size_t exif_core_find_marker_scalar(const unsigned char *p, size_t len);
+extern const char *exif_core_simd_name(void);
+
+/* containers */
+extern int exif_core_is_jpeg(ExifCoreSource *src);
+extern int exif_core_jpeg_next_segment(ExifCoreSource *src, int64_t *pos, ExifJpegSegment *seg);
+extern int exif_core_jpeg_segment(ExifCoreSource *src, int i, ExifJpegSegment *seg);
+extern unsigned char *exif_core_locate(ExifCoreSource *src, unsigned int *size, ExifCoreContainer *container);
+extern ExifData *exif_core_data_new(const unsigned char *block, unsigned int size, int makernote);
+extern ExifData *exif_core_loader(const unsigned char *data, size_t size, int makernote);
+extern ExifData *exif_core_data_from_source(ExifCoreSource *src, ExifCoreContainer *container, int makernote);
+extern uint64_t exif_core_hash64(const unsigned char *data, size_t len, uint64_t seed);
+extern int exif_core_fingerprint(ExifCoreSource *src, uint64_t *hash);
+
+/* values */
+extern ExifEntry *exif_core_entry_by_name(ExifData *edata, const char *tagname);
+extern char *exif_core_tag_value(ExifData *edata, const char *tagname);
+extern int exif_core_gps_point(ExifData *edata, int dest, char *buf, size_t buflen);
+extern int exif_core_datetime_valid(const ExifCoreDateTime *dt);
+extern ExifCoreStatus exif_core_gps_datetime(ExifData *edata, ExifCoreDateTime *dt, ExifCoreInfo *info);
+extern ExifCoreStatus exif_core_datetime(ExifData *edata, ExifTag tag_dt, int use_offset,
+										 ExifCoreDateTime *dt, ExifCoreInfo *info);
+extern ExifCoreStatus exif_core_user_comment(ExifData *edata, char **utf8, ExifCoreInfo *info);
+extern void exif_core_summary(ExifData *edata, ExifCoreSummary *s);
+extern void exif_core_summary_free(ExifCoreSummary *s);
+
+#endif	/* BYTEA_EXIF_CORE_H */
@@ -0,0 +1,560 @@
+/*-------------------------------------------------------------------------
+ *
+ * EXIF data extractor for PotgreSQL bytea data
+ * Reports of EXIF data problems: per row warnings, per statement summary
+ * or nothing, and bytea_exif_diagnose function
+ *
+ * (c) 2025, mkgrgis
+ *
+ * IDENTIFICATION
+ *		bytea_exif_diag.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "bytea_exif.h"
+
+#include "access/xact.h"
+#include "executor/executor.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+#include "utils/tuplestore.h"
+
+Datum bytea_exif_diagnose(PG_FUNCTION_ARGS);
+
+PG_FUNCTION_INFO_V1(bytea_exif_diagnose);
+
+/* Values of bytea_exif.diagnostics */
+typedef enum ExifDiagMode
+{
+	EXIF_DIAG_ROW,
+	EXIF_DIAG_SUMMARY,
+	EXIF_DIAG_OFF
+} ExifDiagMode;
+
+static const struct config_enum_entry exif_diag_options[] = {
+	{"row", EXIF_DIAG_ROW, false},
+	{"summary", EXIF_DIAG_SUMMARY, false},
+	{"off", EXIF_DIAG_OFF, false},
+	{NULL, 0, false}
+};
+
+/* Problems without ExifCoreStatus code */
+#define EXIF_DIAG_UC_ASCII		(EXIF_CORE_NO_MEMORY + 1)
+#define EXIF_DIAG_TAG_NAME		(EXIF_CORE_NO_MEMORY + 2)
+#define EXIF_DIAG_XMP_ENCODING	(EXIF_CORE_NO_MEMORY + 3)
+#define EXIF_DIAG_XMP_XML		(EXIF_CORE_NO_MEMORY + 4)
+#define EXIF_DIAG_OFFSET_FORMAT	(EXIF_CORE_NO_MEMORY + 5)
+#define EXIF_DIAG_NPROBLEMS		(EXIF_CORE_NO_MEMORY + 6)
+
+/* Number of bytea_exif_diagnose columns */
+#define EXIF_DIAG_NATTS	4
+
+typedef struct ExifDiagProblem
+{
+	const char *name;			/* problem column of bytea_exif_diagnose */
+	int			sqlerrcode;
+	int			elevel;			/* WARNING or ERROR in any mode */
+	const char *message;
+} ExifDiagProblem;
+
+static const ExifDiagProblem ExifDiagProblems[EXIF_DIAG_NPROBLEMS] = {
+	[EXIF_CORE_GPS_DATE_FORMAT] = {"gps_date_format", ERRCODE_DATETIME_VALUE_OUT_OF_RANGE, WARNING,
+								   "Invalid GPS date EXIF format"},
+	[EXIF_CORE_GPS_TIME_FORMAT] = {"gps_time_format", ERRCODE_DATETIME_VALUE_OUT_OF_RANGE, WARNING,
+								   "Invalid GPS time EXIF format"},
+	[EXIF_CORE_GPS_TIME_INVALID] = {"gps_time_invalid", ERRCODE_DATETIME_VALUE_OUT_OF_RANGE, WARNING,
+									"Invalid GPS data or GPS time EXIF format"},
+	[EXIF_CORE_GPS_RANGE] = {"gps_range", ERRCODE_DATETIME_VALUE_OUT_OF_RANGE, WARNING,
+							 "GPS date or time EXIF value out of range"},
+	[EXIF_CORE_DATETIME_FORMAT] = {"datetime_format", ERRCODE_INVALID_DATETIME_FORMAT, WARNING,
+								   "Invalid EXIF date and time format"},
+	[EXIF_CORE_DATETIME_RANGE] = {"datetime_range", ERRCODE_DATETIME_VALUE_OUT_OF_RANGE, WARNING,
+								  "EXIF date and time value out of range"},
+	[EXIF_CORE_UC_FORMAT] = {"user_comment_format", ERRCODE_WRONG_OBJECT_TYPE, WARNING,
+							 "Invalid user comment EXIF format"},
+	[EXIF_CORE_UC_NO_TEXT] = {"user_comment_no_text", ERRCODE_WRONG_OBJECT_TYPE, WARNING,
+							  "No EXIF user comment text data"},
+	[EXIF_CORE_UC_ENCODING] = {"user_comment_encoding", ERRCODE_WRONG_OBJECT_TYPE, WARNING,
+							   "Invalid encoding for user comment EXIF data"},
+	[EXIF_CORE_UC_ICONV_OPEN] = {"iconv_open", ERRCODE_UNDEFINED_FUNCTION, ERROR,
+								 "Iconv initialization error"},
+	[EXIF_CORE_UC_ICONV] = {"iconv", ERRCODE_UNDEFINED_FUNCTION, WARNING,
+							"Iconv fail"},
+	[EXIF_CORE_NO_MEMORY] = {"out_of_memory", ERRCODE_OUT_OF_MEMORY, ERROR,
+							 "out of memory"},
+	[EXIF_DIAG_UC_ASCII] = {"user_comment_ascii", ERRCODE_WRONG_OBJECT_TYPE, WARNING,
+							"EXIF user comment have EXIF_ACSII format"},
+	[EXIF_DIAG_TAG_NAME] = {"tag_name", ERRCODE_WARNING, WARNING,
+							"Tag name is not correct"},
+	[EXIF_DIAG_XMP_ENCODING] = {"xmp_encoding", ERRCODE_CHARACTER_NOT_IN_REPERTOIRE, WARNING,
+								"XMP packet is not valid UTF-8"},
+	[EXIF_DIAG_XMP_XML] = {"xmp_xml", ERRCODE_INVALID_XML_DOCUMENT, WARNING,
+						   "XMP packet is not well-formed XML"},
+	[EXIF_DIAG_OFFSET_FORMAT] = {"offset_format", ERRCODE_INVALID_DATETIME_FORMAT, WARNING,
+								 "Invalid EXIF time zone offset format"}
+};
+
+/* GUC variables */
+static int	exif_diagnostics = EXIF_DIAG_ROW;
+
+/* Problems counted in summary mode, reported at end of top level statement */
+static int64 exif_diag_counts[EXIF_DIAG_NPROBLEMS];
+static bool	exif_diag_counted = false;
+
+/*
+ * Counts at start of open subtransactions, restored when a subtransaction
+ * is rolled back. The entries are in TopTransactionContext.
+ */
+typedef struct ExifDiagSubXact
+{
+	SubTransactionId		subid;
+	int64					counts[EXIF_DIAG_NPROBLEMS];
+	bool					counted;
+	struct ExifDiagSubXact *parent;
+} ExifDiagSubXact;
+
+static ExifDiagSubXact *exif_diag_subxacts = NULL;
+
+/* Nesting level of executor calls, 0 is top level statement */
+static int	exif_diag_nesting = 0;
+
+static ExecutorRun_hook_type prev_ExecutorRun = NULL;
+static ExecutorFinish_hook_type prev_ExecutorFinish = NULL;
+static ExecutorEnd_hook_type prev_ExecutorEnd = NULL;
+
+static void exif_diag_ExecutorRun(QueryDesc *queryDesc, ScanDirection direction,
+								  uint64 count, bool execute_once);
+static void exif_diag_ExecutorFinish(QueryDesc *queryDesc);
+static void exif_diag_ExecutorEnd(QueryDesc *queryDesc);
+static void exif_diag_xact_callback(XactEvent event, void *arg);
+static void exif_diag_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
+									   SubTransactionId parentSubid, void *arg);
+
+/*
+ * exif_diag_init
+ * Defines GUC variables and installs executor hooks for the per statement
+ * summary. Called from _PG_init.
+ */
+void
+exif_diag_init(void)
+{
+	DefineCustomEnumVariable("bytea_exif.diagnostics",
+							 "Reports of EXIF data problems.",
+							 "\"row\" is a warning for every problem, \"summary\" is one warning "
+							 "with count of values for every problem kind at end of statement, "
+							 "\"off\" disables the warnings.",
+							 &exif_diagnostics,
+							 EXIF_DIAG_ROW,
+							 exif_diag_options,
+							 PGC_USERSET,
+							 0,
+							 NULL, NULL, NULL);
+
+	prev_ExecutorRun = ExecutorRun_hook;
+	ExecutorRun_hook = exif_diag_ExecutorRun;
+	prev_ExecutorFinish = ExecutorFinish_hook;
+	ExecutorFinish_hook = exif_diag_ExecutorFinish;
+	prev_ExecutorEnd = ExecutorEnd_hook;
+	ExecutorEnd_hook = exif_diag_ExecutorEnd;
+	RegisterXactCallback(exif_diag_xact_callback, NULL);
+	RegisterSubXactCallback(exif_diag_subxact_callback, NULL);
+}
+
+/*
+ * exif_diag_detail
+ * Formats raw EXIF values of a problem. hint is set if the text is a hint
+ * rather than a detail. Returns NULL if there is nothing to show.
+ */
+static char *
+exif_diag_detail(int problem, ExifCoreInfo *info, int64 len, bool *hint)
+{
+	*hint = true;
+	switch (problem)
+	{
+		case EXIF_CORE_GPS_DATE_FORMAT:
+			return psprintf("EXIF code: %d, EXIF length: %u", info->format, info->size);
+		case EXIF_CORE_GPS_TIME_FORMAT:
+			return psprintf("EXIF code: %d", info->format);
+		case EXIF_CORE_GPS_RANGE:
+			return psprintf("Date: %s, time: %u/%u %u/%u %u/%u", info->text,
+							info->rational[0], info->rational[1],
+							info->rational[2], info->rational[3],
+							info->rational[4], info->rational[5]);
+		case EXIF_CORE_DATETIME_FORMAT:
+			return psprintf("EXIF value: \"%s\", normal is \"YYYY:MM:DD HH:MM:SS\"", info->text);
+		case EXIF_CORE_DATETIME_RANGE:
+			return psprintf("EXIF value: \"%s\"", info->text);
+		case EXIF_CORE_UC_FORMAT:
+			*hint = false;
+			return psprintf("Exif code: %d, normal is %d; bytea data length is %d bytes", info->format, EXIF_FORMAT_UNDEFINED, (int) len);
+		case EXIF_CORE_UC_NO_TEXT:
+			return psprintf("Actual field length: %u, minimal is %d; bytea data length is %d bytes", info->size, UC_ENCODING_FIELD_SIZE, (int) len);
+		case EXIF_CORE_UC_ENCODING:
+			*hint = false;
+			return psprintf("Encoding mark %.*s; bytea data length is %d bytes", UC_ENCODING_FIELD_SIZE, info->text, (int) len);
+		case EXIF_CORE_UC_ICONV_OPEN:
+			*hint = false;
+			return psprintf("Encoding mark %.*s", UC_ENCODING_FIELD_SIZE, info->text);
+		case EXIF_CORE_UC_ICONV:
+			return psprintf("Encoding mark %.*s; bytea data length is %d bytes", UC_ENCODING_FIELD_SIZE, info->text, (int) len);
+		case EXIF_CORE_NO_MEMORY:
+			return psprintf("bytea data length is %d bytes", (int) len);
+		case EXIF_DIAG_UC_ASCII:
+			return psprintf("Should be marked as EXIF undefined data; bytea data length is %d bytes", (int) len);
+		case EXIF_DIAG_XMP_ENCODING:
+		case EXIF_DIAG_XMP_XML:
+			return psprintf("bytea data length is %d bytes", (int) len);
+		case EXIF_DIAG_OFFSET_FORMAT:
+			return psprintf("EXIF value: \"%s\", normal is \"+HH:MM\", the time is read as UTC", info->offset);
+		default:
+			return NULL;
+	}
+}
+
+/*
+ * exif_diag_report
+ * Reports one problem according bytea_exif.diagnostics. Errors are raised in
+ * any mode. detail is formatted only for per row warnings.
+ */
+static void
+exif_diag_report(int problem, ExifCoreInfo *info, int64 len, const char *tagname)
+{
+	const ExifDiagProblem *p = &ExifDiagProblems[problem];
+	char	   *detail;
+	bool		hint;
+
+	if (p->elevel < ERROR)
+	{
+		if (exif_diagnostics == EXIF_DIAG_OFF)
+			return;
+		if (exif_diagnostics == EXIF_DIAG_SUMMARY)
+		{
+			exif_diag_counts[problem]++;
+			exif_diag_counted = true;
+			return;
+		}
+	}
+
+	if (problem == EXIF_DIAG_TAG_NAME)
+	{
+		detail = psprintf("Please read EXIF specification and search for \"%s\"", tagname);
+		hint = true;
+	}
+	else
+		detail = exif_diag_detail(problem, info, len, &hint);
+
+	ereport(p->elevel,
+		(errcode(p->sqlerrcode),
+		 errmsg("%s", p->message),
+		 detail == NULL ? 0 : hint ? errhint("%s", detail) : errdetail("%s", detail)));
+}
+
+/*
+ * exif_report_status
+ * Reports a problem of EXIF data found by the core. len is bytea data length
+ * for hints.
+ */
+void
+exif_report_status(ExifCoreStatus status, ExifCoreInfo *info, int64 len)
+{
+	if (info->ascii_format)
+		exif_diag_report(EXIF_DIAG_UC_ASCII, info, len, NULL);
+	if (info->offset_format)
+		exif_diag_report(EXIF_DIAG_OFFSET_FORMAT, info, len, NULL);
+	if (status != EXIF_CORE_OK && status != EXIF_CORE_NO_VALUE)
+		exif_diag_report(status, info, len, NULL);
+}
+
+/*
+ * exif_report_tag_name
+ * Reports a tag name not known to libexif.
+ */
+void
+exif_report_tag_name(const char *tagname)
+{
+	exif_diag_report(EXIF_DIAG_TAG_NAME, NULL, 0, tagname);
+}
+
+/*
+ * exif_report_xmp
+ * Reports XMP packet not valid as UTF-8 text or as XML.
+ */
+void
+exif_report_xmp(bool xml, int64 len)
+{
+	exif_diag_report(xml ? EXIF_DIAG_XMP_XML : EXIF_DIAG_XMP_ENCODING, NULL, len, NULL);
+}
+
+/*
+ * exif_diag_summary
+ * Reports problems counted in summary mode, one warning for every problem
+ * kind, and resets the counts.
+ */
+static void
+exif_diag_summary(void)
+{
+	if (!exif_diag_counted)
+		return;
+	exif_diag_counted = false;
+	/* reported problems are not restored by rollback of a subtransaction */
+	for (ExifDiagSubXact *sx = exif_diag_subxacts; sx != NULL; sx = sx->parent)
+	{
+		memset(sx->counts, 0, sizeof(sx->counts));
+		sx->counted = false;
+	}
+	for (int i = 0; i < EXIF_DIAG_NPROBLEMS; i++)
+	{
+		int64		n = exif_diag_counts[i];
+
+		if (n == 0)
+			continue;
+		exif_diag_counts[i] = 0;
+		ereport(WARNING,
+			(errcode(ExifDiagProblems[i].sqlerrcode),
+			 errmsg_plural("%s in " INT64_FORMAT " value",
+						   "%s in " INT64_FORMAT " values",
+						   n, ExifDiagProblems[i].message, n),
+			 errhint("Use bytea_exif_diagnose function or set bytea_exif.diagnostics to \"row\" for details")));
+	}
+}
+
+static void
+exif_diag_ExecutorRun(QueryDesc *queryDesc, ScanDirection direction,
+					  uint64 count, bool execute_once)
+{
+	exif_diag_nesting++;
+	PG_TRY();
+	{
+		if (prev_ExecutorRun)
+			prev_ExecutorRun(queryDesc, direction, count, execute_once);
+		else
+			standard_ExecutorRun(queryDesc, direction, count, execute_once);
+		exif_diag_nesting--;
+	}
+	PG_CATCH();
+	{
+		exif_diag_nesting--;
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+}
+
+static void
+exif_diag_ExecutorFinish(QueryDesc *queryDesc)
+{
+	exif_diag_nesting++;
+	PG_TRY();
+	{
+		if (prev_ExecutorFinish)
+			prev_ExecutorFinish(queryDesc);
+		else
+			standard_ExecutorFinish(queryDesc);
+		exif_diag_nesting--;
+	}
+	PG_CATCH();
+	{
+		exif_diag_nesting--;
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+}
+
+/*
+ * exif_diag_ExecutorEnd
+ * End of a statement. Queries of functions called by the statement are
+ * executed at higher nesting level, hence only the top level statement
+ * reports the summary.
+ */
+static void
+exif_diag_ExecutorEnd(QueryDesc *queryDesc)
+{
+	if (prev_ExecutorEnd)
+		prev_ExecutorEnd(queryDesc);
+	else
+		standard_ExecutorEnd(queryDesc);
+	if (exif_diag_nesting == 0)
+		exif_diag_summary();
+}
+
+/*
+ * exif_diag_xact_callback
+ * Problems counted outside of executor, for example by triggers of COPY,
+ * are reported before commit. Counts of failed transaction are dropped.
+ */
+static void
+exif_diag_xact_callback(XactEvent event, void *arg)
+{
+	switch (event)
+	{
+		case XACT_EVENT_PRE_COMMIT:
+		case XACT_EVENT_PARALLEL_PRE_COMMIT:
+			exif_diag_summary();
+			break;
+		case XACT_EVENT_ABORT:
+		case XACT_EVENT_PARALLEL_ABORT:
+			memset(exif_diag_counts, 0, sizeof(exif_diag_counts));
+			exif_diag_counted = false;
+			exif_diag_subxacts = NULL;
+			break;
+		case XACT_EVENT_COMMIT:
+		case XACT_EVENT_PARALLEL_COMMIT:
+		case XACT_EVENT_PREPARE:
+			exif_diag_subxacts = NULL;
+			break;
+		default:
+			break;
+	}
+}
+
+/*
+ * exif_diag_subxact_callback
+ * Saves counts at start of a subtransaction. Problems counted in a rolled
+ * back subtransaction or savepoint are dropped, if they were not reported
+ * yet.
+ */
+static void
+exif_diag_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
+						   SubTransactionId parentSubid, void *arg)
+{
+	ExifDiagSubXact *sx = exif_diag_subxacts;
+
+	switch (event)
+	{
+		case SUBXACT_EVENT_START_SUB:
+			sx = MemoryContextAlloc(TopTransactionContext, sizeof(ExifDiagSubXact));
+			sx->subid = mySubid;
+			memcpy(sx->counts, exif_diag_counts, sizeof(exif_diag_counts));
+			sx->counted = exif_diag_counted;
+			sx->parent = exif_diag_subxacts;
+			exif_diag_subxacts = sx;
+			break;
+		case SUBXACT_EVENT_COMMIT_SUB:
+		case SUBXACT_EVENT_ABORT_SUB:
+			if (sx == NULL || sx->subid != mySubid)
+				break;
+			if (event == SUBXACT_EVENT_ABORT_SUB)
+			{
+				memcpy(exif_diag_counts, sx->counts, sizeof(exif_diag_counts));
+				exif_diag_counted = sx->counted;
+			}
+			exif_diag_subxacts = sx->parent;
+			pfree(sx);
+			break;
+		default:
+			break;
+	}
+}
+
+/*
+ * exif_diag_put
+ * Adds a bytea_exif_diagnose row for a status of the core.
+ */
+static void
+exif_diag_put(Tuplestorestate *tupstore, TupleDesc tupdesc, const char *tag,
+			  int problem, ExifCoreInfo *info, int64 len)
+{
+	Datum		values[EXIF_DIAG_NATTS];
+	bool		nulls[EXIF_DIAG_NATTS];
+	char	   *detail;
+	bool		hint;
+
+	detail = exif_diag_detail(problem, info, len, &hint);
+	memset(nulls, false, sizeof(nulls));
+	values[0] = CStringGetTextDatum(tag);
+	values[1] = CStringGetTextDatum(ExifDiagProblems[problem].name);
+	values[2] = CStringGetTextDatum(ExifDiagProblems[problem].message);
+	nulls[3] = detail == NULL;
+	if (detail != NULL)
+		values[3] = CStringGetTextDatum(detail);
+	tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+}
+
+/*
+ * bytea_exif_diagnose
+ * All problems of EXIF values of an image as rows. Independent of
+ * bytea_exif.diagnostics, the problems are not reported as warnings.
+ */
+Datum
+bytea_exif_diagnose(PG_FUNCTION_ARGS)
+{
+	static const ExifTag datetime_tags[] = {EXIF_TAG_DATE_TIME,
+											EXIF_TAG_DATE_TIME_ORIGINAL,
+											EXIF_TAG_DATE_TIME_DIGITIZED};
+	/* names of the offset tags are not known to old libexif versions */
+	static const char *const offset_tags[] = {"OffsetTime",
+											  "OffsetTimeOriginal",
+											  "OffsetTimeDigitized"};
+	Datum			arg = PG_GETARG_DATUM(0);
+	int64			len = exif_datum_size(arg);
+	ReturnSetInfo  *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc		tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext	oldcontext;
+	ExifData	   *edata = NULL;
+	ExifCoreDateTime dt;
+	TimestampTz		ts;
+	ExifCoreInfo	info;
+	ExifCoreStatus	status;
+	char		   *utf8 = NULL;
+
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("materialize mode required, but it is not allowed in this context")));
+
+	oldcontext = MemoryContextSwitchTo(rsinfo->econtext->ecxt_per_query_memory);
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		ereport(ERROR,
+			(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+			 errmsg("function returning record called in context that cannot accept type record")));
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+	MemoryContextSwitchTo(oldcontext);
+
+	if (len > 0)
+		edata = exif_data_from_datum(arg);
+	if (edata == NULL) /* no EXIF data structure */
+		return (Datum) 0;
+
+	for (int i = 0; i < lengthof(datetime_tags); i++)
+	{
+		status = exif_core_datetime(edata, datetime_tags[i], true, &dt, &info);
+		if (info.offset_format)
+			exif_diag_put(tupstore, tupdesc, offset_tags[i], EXIF_DIAG_OFFSET_FORMAT, &info, len);
+		if (status == EXIF_CORE_OK && !exif_tm_to_timestamptz(&dt, &ts))
+			status = EXIF_CORE_DATETIME_RANGE;
+		if (status != EXIF_CORE_OK && status != EXIF_CORE_NO_VALUE)
+			exif_diag_put(tupstore, tupdesc, exif_tag_get_name(datetime_tags[i]), status, &info, len);
+	}
+
+	status = exif_core_gps_datetime(edata, &dt, &info);
+	if (status == EXIF_CORE_OK && !exif_tm_to_timestamptz(&dt, &ts))
+		status = EXIF_CORE_DATETIME_RANGE;
+	if (status != EXIF_CORE_OK && status != EXIF_CORE_NO_VALUE)
+		exif_diag_put(tupstore, tupdesc,
+					  status == EXIF_CORE_GPS_DATE_FORMAT ? "GPSDateStamp" : "GPSTimeStamp",
+					  status, &info, len);
+
+	status = exif_core_user_comment(edata, &utf8, &info);
+	if (utf8 != NULL)
+		free(utf8);
+	if (info.ascii_format)
+		exif_diag_put(tupstore, tupdesc, "UserComment", EXIF_DIAG_UC_ASCII, &info, len);
+	if (status != EXIF_CORE_OK && status != EXIF_CORE_NO_VALUE)
+		exif_diag_put(tupstore, tupdesc, "UserComment", status, &info, len);
+
+	exif_data_free (edata);
+	return (Datum) 0;
+}
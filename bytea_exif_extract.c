@@ -0,0 +1,882 @@
+/*-------------------------------------------------------------------------
+ *
+ * EXIF data extractor for PotgreSQL bytea data
+ * bytea_exif_extract: standalone multithreaded bulk extractor. Walks files
+ * and directories, maps every file to memory and writes one COPY row per file
+ * with the columns of bytea_exif_summary SQL function. Extraction is done by
+ * the same core code as in the extension.
+ *
+ * Usage: bytea_exif_extract [-j threads] [-b] [-v] [-L] [-o file] path ...
+ *
+ * (c) 2025, mkgrgis
+ *
+ * IDENTIFICATION
+ *		bytea_exif_extract.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bytea_exif_core.h"
+
+/* Columns: path and columns of bytea_exif_summary */
+#define EXTRACT_NATTS		10
+#define EXTRACT_FLUSH_SIZE	(64 * 1024)
+/* Julian day of 2000-01-01, PostgreSQL timestamp epoch */
+#define EXTRACT_EPOCH_JDATE	2451545
+#define USECS_PER_DAY		INT64_C(86400000000)
+
+/* Output row buffer of a thread */
+typedef struct ExtractBuf
+{
+	char	   *data;
+	size_t		len;
+	size_t		cap;
+} ExtractBuf;
+
+/*
+ * Work-stealing deque of paths. The owner thread pushes and pops at the
+ * tail, other threads steal at the head, hence directory trees are walked
+ * depth first by the owner and broad by thieves.
+ */
+typedef struct ExtractDeque
+{
+	pthread_mutex_t	lock;
+	char		  **items;
+	size_t			head;
+	size_t			tail;
+	size_t			cap;
+} ExtractDeque;
+
+/* Directory identity for -L, symbolic links can make cycles */
+typedef struct ExtractDirId
+{
+	dev_t		dev;
+	ino_t		ino;
+} ExtractDirId;
+
+typedef struct ExtractWorker
+{
+	pthread_t		thread;
+	int				id;
+	ExtractDeque	deque;
+	ExtractBuf		out;
+} ExtractWorker;
+
+static ExtractWorker   *workers;
+static int				nworkers;
+static bool				binary_format = false;
+static bool				verbose = false;
+static bool				follow_links = false;
+static FILE			   *output;
+static pthread_mutex_t	output_lock = PTHREAD_MUTEX_INITIALIZER;
+/*
+ * Paths in the deques and paths queued or in work, the work is done when
+ * pending is 0. Idle workers sleep on the condition until a path is queued.
+ */
+static pthread_mutex_t	pending_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	pending_cond = PTHREAD_COND_INITIALIZER;
+static long				queued = 0;
+static long				pending = 0;
+static bool				failed = false;
+/* Open addressing hash set of visited directories, used only with -L */
+static pthread_mutex_t	visited_lock = PTHREAD_MUTEX_INITIALIZER;
+static ExtractDirId	   *visited = NULL;
+static size_t			nvisited = 0;
+static size_t			visited_cap = 0;
+
+static const char *const status_names[] = {
+	"ok",
+	"no value",
+	"invalid GPS date EXIF format",
+	"invalid GPS time EXIF format",
+	"invalid GPS data or GPS time EXIF format",
+	"GPS date or time EXIF value out of range",
+	"invalid EXIF date and time format",
+	"EXIF date and time value out of range",
+	"invalid user comment EXIF format",
+	"no EXIF user comment text data",
+	"invalid encoding for user comment EXIF data",
+	"iconv initialization error",
+	"iconv fail",
+	"out of memory"
+};
+
+static void
+extract_oom(void)
+{
+	fprintf(stderr, "bytea_exif_extract: out of memory\n");
+	exit(2);
+}
+
+static void *
+extract_malloc(size_t size)
+{
+	void	   *res = malloc(size);
+
+	if (res == NULL)
+		extract_oom();
+	return res;
+}
+
+/*
+ * Deque operations
+ */
+static void
+deque_push(ExtractDeque *dq, char *path)
+{
+	pthread_mutex_lock(&dq->lock);
+	if (dq->tail == dq->cap)
+	{
+		if (dq->head > 0)
+		{
+			memmove(dq->items, dq->items + dq->head, (dq->tail - dq->head) * sizeof(char *));
+			dq->tail -= dq->head;
+			dq->head = 0;
+		}
+		if (dq->tail == dq->cap)
+		{
+			dq->cap = dq->cap ? dq->cap * 2 : 64;
+			dq->items = realloc(dq->items, dq->cap * sizeof(char *));
+			if (dq->items == NULL)
+				extract_oom();
+		}
+	}
+	dq->items[dq->tail++] = path;
+	pthread_mutex_unlock(&dq->lock);
+}
+
+static char *
+deque_pop(ExtractDeque *dq)
+{
+	char	   *res = NULL;
+
+	pthread_mutex_lock(&dq->lock);
+	if (dq->tail > dq->head)
+		res = dq->items[--dq->tail];
+	pthread_mutex_unlock(&dq->lock);
+	return res;
+}
+
+static char *
+deque_steal(ExtractDeque *dq)
+{
+	char	   *res = NULL;
+
+	/* do not wait for a busy victim, try the next one */
+	if (pthread_mutex_trylock(&dq->lock) != 0)
+		return NULL;
+	if (dq->tail > dq->head)
+		res = dq->items[dq->head++];
+	pthread_mutex_unlock(&dq->lock);
+	return res;
+}
+
+/*
+ * Task accounting
+ */
+static void
+task_push(ExtractDeque *dq, char *path)
+{
+	pthread_mutex_lock(&pending_lock);
+	pending++;
+	queued++;
+	pthread_cond_signal(&pending_cond);
+	pthread_mutex_unlock(&pending_lock);
+	deque_push(dq, path);
+}
+
+static void
+task_taken(void)
+{
+	pthread_mutex_lock(&pending_lock);
+	queued--;
+	pthread_mutex_unlock(&pending_lock);
+}
+
+static void
+task_done(void)
+{
+	pthread_mutex_lock(&pending_lock);
+	if (--pending == 0)
+		pthread_cond_broadcast(&pending_cond);
+	pthread_mutex_unlock(&pending_lock);
+}
+
+/*
+ * task_wait
+ * Sleeps while there is no queued path but some paths are in work and can
+ * queue directory entries. Returns false when all of the work is done.
+ */
+static bool
+task_wait(void)
+{
+	bool		res;
+
+	pthread_mutex_lock(&pending_lock);
+	while (pending > 0 && queued == 0)
+		pthread_cond_wait(&pending_cond, &pending_lock);
+	res = pending > 0;
+	pthread_mutex_unlock(&pending_lock);
+	return res;
+}
+
+/*
+ * Output buffer operations
+ */
+static void
+buf_reserve(ExtractBuf *b, size_t n)
+{
+	if (b->len + n <= b->cap)
+		return;
+	while (b->len + n > b->cap)
+		b->cap = b->cap ? b->cap * 2 : EXTRACT_FLUSH_SIZE * 2;
+	b->data = realloc(b->data, b->cap);
+	if (b->data == NULL)
+		extract_oom();
+}
+
+static void
+buf_append(ExtractBuf *b, const void *p, size_t n)
+{
+	buf_reserve(b, n);
+	memcpy(b->data + b->len, p, n);
+	b->len += n;
+}
+
+static void
+buf_append_be(ExtractBuf *b, uint64_t v, int n)
+{
+	unsigned char	tmp[8];
+
+	for (int i = n - 1; i >= 0; i--)
+	{
+		tmp[i] = v & 0xFF;
+		v >>= 8;
+	}
+	buf_append(b, tmp, n);
+}
+
+static void
+buf_flush(ExtractBuf *b)
+{
+	if (b->len == 0)
+		return;
+	pthread_mutex_lock(&output_lock);
+	if (fwrite(b->data, 1, b->len, output) != b->len)
+		failed = true;
+	pthread_mutex_unlock(&output_lock);
+	b->len = 0;
+}
+
+/*
+ * COPY field writers. Text format fields are separated by tab, binary format
+ * fields have length word.
+ */
+static void
+field_null(ExtractBuf *b, int col)
+{
+	if (binary_format)
+		buf_append_be(b, (uint32_t) -1, 4);
+	else
+	{
+		if (col > 0)
+			buf_append(b, "\t", 1);
+		buf_append(b, "\\N", 2);
+	}
+}
+
+static void
+field_text(ExtractBuf *b, int col, const char *s)
+{
+	size_t		n;
+
+	if (s == NULL)
+	{
+		field_null(b, col);
+		return;
+	}
+	n = strlen(s);
+	if (binary_format)
+	{
+		buf_append_be(b, (uint32_t) n, 4);
+		buf_append(b, s, n);
+		return;
+	}
+	if (col > 0)
+		buf_append(b, "\t", 1);
+	for (const char *c = s; *c; c++)
+	{
+		switch (*c)
+		{
+			case '\\':
+				buf_append(b, "\\\\", 2);
+				break;
+			case '\t':
+				buf_append(b, "\\t", 2);
+				break;
+			case '\n':
+				buf_append(b, "\\n", 2);
+				break;
+			case '\r':
+				buf_append(b, "\\r", 2);
+				break;
+			default:
+				buf_append(b, c, 1);
+		}
+	}
+}
+
+static void
+field_bool(ExtractBuf *b, int col, bool v)
+{
+	if (binary_format)
+	{
+		buf_append_be(b, 1, 4);
+		buf_append_be(b, v ? 1 : 0, 1);
+	}
+	else
+		field_text(b, col, v ? "t" : "f");
+}
+
+/* date2j and j2date of PostgreSQL */
+static int64_t
+extract_date2j(int y, int m, int d)
+{
+	int64_t		julian;
+	int64_t		century;
+
+	if (m > 2)
+	{
+		m += 1;
+		y += 4800;
+	}
+	else
+	{
+		m += 13;
+		y += 4799;
+	}
+	century = y / 100;
+	julian = (int64_t) y * 365 - 32167;
+	julian += y / 4 - century + century / 4;
+	julian += 7834 * m / 256 + d;
+	return julian;
+}
+
+static void
+extract_j2date(int64_t jd, int *year, int *month, int *day)
+{
+	uint64_t	julian = jd + 32044;
+	uint64_t	quad = julian / 146097;
+	uint64_t	extra = (julian - quad * 146097) * 4 + 3;
+	int			y;
+
+	julian += 60 + quad * 3 + extra / 146097;
+	quad = julian / 1461;
+	julian -= quad * 1461;
+	y = julian * 4 / 1461;
+	julian = ((y != 0) ? ((julian + 305) % 365) : ((julian + 306) % 366)) + 123;
+	y += quad * 4;
+	*year = y - 4800;
+	quad = julian * 2141 / 65536;
+	*day = julian - 7834 * quad / 256;
+	*month = (quad + 10) % 12 + 1;
+}
+
+/*
+ * field_timestamptz
+ * Writes date and time found by the core as timestamptz: microseconds from
+ * 2000-01-01 UTC in binary format, UTC time with "+00" in text format.
+ * Problems are reported as in the extension, but to stderr.
+ */
+static void
+field_timestamptz(ExtractBuf *b, int col, ExifCoreStatus status, const ExifCoreDateTime *dt, const char *path)
+{
+	int64_t		days;
+	int64_t		ts;
+	int64_t		time;
+	int			y, m, d;
+	char		str[64];
+	int			n;
+
+	if (status == EXIF_CORE_OK && !exif_core_datetime_valid(dt))
+		status = EXIF_CORE_DATETIME_RANGE;
+	if (status != EXIF_CORE_OK)
+	{
+		if (status != EXIF_CORE_NO_VALUE && verbose)
+			fprintf(stderr, "bytea_exif_extract: %s: %s\n", path, status_names[status]);
+		field_null(b, col);
+		return;
+	}
+
+	days = extract_date2j(dt->year, dt->month, dt->day) - EXTRACT_EPOCH_JDATE;
+	ts = days * USECS_PER_DAY +
+		((int64_t) (dt->hour * 3600 + dt->minute * 60 + dt->second - dt->tz)) * 1000000 +
+		dt->usec;
+	if (binary_format)
+	{
+		buf_append_be(b, 8, 4);
+		buf_append_be(b, (uint64_t) ts, 8);
+		return;
+	}
+
+	days = ts / USECS_PER_DAY;
+	time = ts % USECS_PER_DAY;
+	if (time < 0)
+	{
+		time += USECS_PER_DAY;
+		days--;
+	}
+	extract_j2date(days + EXTRACT_EPOCH_JDATE, &y, &m, &d);
+	n = snprintf(str, sizeof(str), "%04d-%02d-%02d %02d:%02d:%02d",
+				 y, m, d,
+				 (int) (time / INT64_C(3600000000)),
+				 (int) (time / 60000000 % 60),
+				 (int) (time / 1000000 % 60));
+	if (time % 1000000 != 0)
+		n += snprintf(str + n, sizeof(str) - n, ".%06d", (int) (time % 1000000));
+	snprintf(str + n, sizeof(str) - n, "+00");
+	field_text(b, col, str);
+}
+
+/*
+ * Memory mapped file as the core data source
+ */
+typedef struct ExtractMap
+{
+	const unsigned char	   *base;
+	int64_t					size;
+} ExtractMap;
+
+static const unsigned char *
+extract_map_fetch(void *arg, int64_t off, int32_t len)
+{
+	ExtractMap *map = (ExtractMap *) arg;
+
+	if (off < 0 || len < 0 || off + len > map->size)
+		return NULL;
+	return map->base + off;
+}
+
+/*
+ * extract_file
+ * Writes COPY row for a regular file.
+ */
+static void
+extract_file(ExtractWorker *w, const char *path, int64_t size)
+{
+	ExifData		   *edata = NULL;
+	ExifCoreSummary		s;
+	void			   *base = NULL;
+	ExtractBuf		   *b = &w->out;
+
+	if (size > 0)
+	{
+		int			fd = open(path, O_RDONLY);
+
+		if (fd < 0)
+		{
+			fprintf(stderr, "bytea_exif_extract: could not open \"%s\": %s\n", path, strerror(errno));
+			return;
+		}
+		base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (base == MAP_FAILED)
+		{
+			fprintf(stderr, "bytea_exif_extract: could not map \"%s\": %s\n", path, strerror(errno));
+			return;
+		}
+	}
+
+	if (base != NULL)
+	{
+		ExtractMap			map = {base, size};
+		ExifCoreSource		src = {extract_map_fetch, &map, size};
+		ExifCoreContainer	container;
+
+		edata = exif_core_data_from_source(&src, &container, 0);
+		if (container == EXIF_CONTAINER_OTHER)
+			edata = exif_core_loader(base, size, 0);
+	}
+	exif_core_summary(edata, &s);
+	if (edata != NULL)
+		exif_data_free(edata);
+	if (base != NULL)
+		munmap(base, size);
+
+	if (binary_format)
+		buf_append_be(b, EXTRACT_NATTS, 2);
+	field_text(b, 0, path);
+	field_bool(b, 1, s.has_exif != 0);
+	field_text(b, 2, s.make);
+	field_text(b, 3, s.model);
+	field_text(b, 4, s.lens_model);
+	if (s.datetime_info.offset_format && verbose)
+		fprintf(stderr, "bytea_exif_extract: %s: invalid EXIF time zone offset format \"%s\", read as UTC\n",
+				path, s.datetime_info.offset);
+	field_timestamptz(b, 5, s.datetime_status, &s.datetime_original, path);
+	field_timestamptz(b, 6, s.gps_status, &s.gps_utc, path);
+	field_text(b, 7, s.point);
+	field_text(b, 8, s.dest_point);
+	if (s.uc_status != EXIF_CORE_OK && s.uc_status != EXIF_CORE_NO_VALUE && verbose)
+		fprintf(stderr, "bytea_exif_extract: %s: %s\n", path, status_names[s.uc_status]);
+	field_text(b, 9, s.uc_status == EXIF_CORE_OK ? s.user_comment : NULL);
+	if (!binary_format)
+		buf_append(b, "\n", 1);
+	exif_core_summary_free(&s);
+
+	if (b->len >= EXTRACT_FLUSH_SIZE)
+		buf_flush(b);
+}
+
+/*
+ * extract_utf8_valid
+ * Checks UTF-8 like PostgreSQL does: no overlong forms, surrogates or code
+ * points beyond U+10FFFF. Other paths can not be loaded as text.
+ */
+static bool
+extract_utf8_valid(const char *str)
+{
+	const unsigned char *p = (const unsigned char *) str;
+
+	while (*p)
+	{
+		int			n;
+		uint32_t	cp;
+		uint32_t	min;
+
+		if (*p < 0x80)
+		{
+			p++;
+			continue;
+		}
+		if ((*p & 0xe0) == 0xc0)
+		{
+			n = 1;
+			cp = *p & 0x1f;
+			min = 0x80;
+		}
+		else if ((*p & 0xf0) == 0xe0)
+		{
+			n = 2;
+			cp = *p & 0x0f;
+			min = 0x800;
+		}
+		else if ((*p & 0xf8) == 0xf0)
+		{
+			n = 3;
+			cp = *p & 0x07;
+			min = 0x10000;
+		}
+		else
+			return false;
+		for (p++; n > 0; n--, p++)
+		{
+			if ((*p & 0xc0) != 0x80)
+				return false;
+			cp = (cp << 6) | (*p & 0x3f);
+		}
+		if (cp < min || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff))
+			return false;
+	}
+	return true;
+}
+
+static size_t
+extract_dir_slot(dev_t dev, ino_t ino, size_t cap)
+{
+	return ((uint64_t) dev * 31 + (uint64_t) ino) * UINT64_C(0x9e3779b97f4a7c15) % cap;
+}
+
+/*
+ * extract_visit
+ * Adds a directory to the visited set. Returns false if the directory was
+ * visited before.
+ */
+static bool
+extract_visit(const struct stat *st)
+{
+	size_t		i;
+
+	pthread_mutex_lock(&visited_lock);
+	if (2 * (nvisited + 1) > visited_cap)
+	{
+		size_t			cap = visited_cap ? visited_cap * 2 : 256;
+		ExtractDirId   *set = calloc(cap, sizeof(ExtractDirId));
+
+		if (set == NULL)
+			extract_oom();
+		/* dev 0 and ino 0 is an empty slot */
+		for (size_t j = 0; j < visited_cap; j++)
+		{
+			ExtractDirId   *id = &visited[j];
+
+			if (id->dev == 0 && id->ino == 0)
+				continue;
+			i = extract_dir_slot(id->dev, id->ino, cap);
+			while (set[i].dev != 0 || set[i].ino != 0)
+				i = (i + 1) % cap;
+			set[i] = *id;
+		}
+		free(visited);
+		visited = set;
+		visited_cap = cap;
+	}
+	i = extract_dir_slot(st->st_dev, st->st_ino, visited_cap);
+	while (visited[i].dev != 0 || visited[i].ino != 0)
+	{
+		if (visited[i].dev == st->st_dev && visited[i].ino == st->st_ino)
+		{
+			pthread_mutex_unlock(&visited_lock);
+			return false;
+		}
+		i = (i + 1) % visited_cap;
+	}
+	visited[i].dev = st->st_dev;
+	visited[i].ino = st->st_ino;
+	nvisited++;
+	pthread_mutex_unlock(&visited_lock);
+	return true;
+}
+
+/*
+ * extract_dir_link
+ * Returns true if a directory entry is a symbolic link to a directory.
+ * Without -L such links are skipped, they can make cycles.
+ */
+static bool
+extract_dir_link(const char *path, const struct dirent *de)
+{
+	struct stat		st;
+
+#ifdef DT_LNK
+	if (de->d_type != DT_LNK && de->d_type != DT_UNKNOWN)
+		return false;
+#endif
+	if (lstat(path, &st) != 0 || !S_ISLNK(st.st_mode))
+		return false;
+	return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+/*
+ * extract_dir
+ * Queues directory entries to own deque of the worker.
+ */
+static void
+extract_dir(ExtractWorker *w, const char *path)
+{
+	DIR			   *dir = opendir(path);
+	struct dirent  *de;
+	size_t			plen = strlen(path);
+
+	if (dir == NULL)
+	{
+		fprintf(stderr, "bytea_exif_extract: could not open directory \"%s\": %s\n", path, strerror(errno));
+		return;
+	}
+	while ((de = readdir(dir)) != NULL)
+	{
+		size_t		nlen = strlen(de->d_name);
+		char	   *child;
+
+		if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+			continue;
+		child = extract_malloc(plen + nlen + 2);
+		memcpy(child, path, plen);
+		if (plen > 0 && path[plen - 1] == '/')
+			memcpy(child + plen, de->d_name, nlen + 1);
+		else
+		{
+			child[plen] = '/';
+			memcpy(child + plen + 1, de->d_name, nlen + 1);
+		}
+		if (!follow_links && extract_dir_link(child, de))
+		{
+			if (verbose)
+				fprintf(stderr, "bytea_exif_extract: symbolic link to directory \"%s\" skipped\n", child);
+			free(child);
+			continue;
+		}
+		task_push(&w->deque, child);
+	}
+	closedir(dir);
+}
+
+static void
+extract_path(ExtractWorker *w, const char *path)
+{
+	struct stat		st;
+
+	if (!extract_utf8_valid(path))
+	{
+		fprintf(stderr, "bytea_exif_extract: path \"%s\" is not valid UTF-8, skipped\n", path);
+		return;
+	}
+	if (stat(path, &st) != 0)
+	{
+		fprintf(stderr, "bytea_exif_extract: could not stat \"%s\": %s\n", path, strerror(errno));
+		return;
+	}
+	if (S_ISDIR(st.st_mode))
+	{
+		if (follow_links && !extract_visit(&st))
+		{
+			if (verbose)
+				fprintf(stderr, "bytea_exif_extract: directory \"%s\" already visited, skipped\n", path);
+			return;
+		}
+		extract_dir(w, path);
+	}
+	else if (S_ISREG(st.st_mode))
+		extract_file(w, path, st.st_size);
+}
+
+static void *
+extract_worker_main(void *arg)
+{
+	ExtractWorker  *w = (ExtractWorker *) arg;
+
+	for (;;)
+	{
+		char	   *path = deque_pop(&w->deque);
+
+		for (int i = 1; path == NULL && i < nworkers; i++)
+			path = deque_steal(&workers[(w->id + i) % nworkers].deque);
+
+		if (path == NULL)
+		{
+			if (!task_wait())
+				break;
+			continue;
+		}
+		task_taken();
+		extract_path(w, path);
+		free(path);
+		task_done();
+	}
+	buf_flush(&w->out);
+	return NULL;
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+			"Usage: bytea_exif_extract [-j threads] [-b] [-v] [-L] [-o file] path ...\n"
+			"Writes COPY data with columns (path, has_exif, make, model, lens_model,\n"
+			"datetime_original, gps_utc_timestamp, point, dest_point, user_comment)\n"
+			"for all files of the paths.\n"
+			"  -j threads  number of threads, default is number of CPUs\n"
+			"  -b          COPY binary format, default is COPY text format\n"
+			"  -v          report EXIF data problems to stderr\n"
+			"  -L          follow symbolic links to directories\n"
+			"  -o file     output file, default is stdout\n");
+	exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+	int			c;
+	const char *outname = NULL;
+	long		ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+	nworkers = ncpu > 0 ? (int) ncpu : 1;
+	while ((c = getopt(argc, argv, "j:bvLo:h")) != -1)
+	{
+		switch (c)
+		{
+			case 'j':
+				nworkers = atoi(optarg);
+				if (nworkers < 1)
+					usage();
+				break;
+			case 'b':
+				binary_format = true;
+				break;
+			case 'v':
+				verbose = true;
+				break;
+			case 'L':
+				follow_links = true;
+				break;
+			case 'o':
+				outname = optarg;
+				break;
+			default:
+				usage();
+		}
+	}
+	if (optind >= argc)
+		usage();
+
+	output = outname ? fopen(outname, "wb") : stdout;
+	if (output == NULL)
+	{
+		fprintf(stderr, "bytea_exif_extract: could not open \"%s\": %s\n", outname, strerror(errno));
+		return 1;
+	}
+	if (binary_format)
+	{
+		/* signature, flags, header extension length */
+		fwrite("PGCOPY\n\377\r\n\0", 1, 11, output);
+		fwrite("\0\0\0\0\0\0\0\0", 1, 8, output);
+	}
+
+	workers = calloc(nworkers, sizeof(ExtractWorker));
+	if (workers == NULL)
+		extract_oom();
+	for (int i = 0; i < nworkers; i++)
+	{
+		workers[i].id = i;
+		pthread_mutex_init(&workers[i].deque.lock, NULL);
+	}
+	for (int i = optind; i < argc; i++)
+	{
+		char	   *path = strdup(argv[i]);
+
+		if (path == NULL)
+			extract_oom();
+		task_push(&workers[(i - optind) % nworkers].deque, path);
+	}
+
+	for (int i = 0; i < nworkers; i++)
+	{
+		if (pthread_create(&workers[i].thread, NULL, extract_worker_main, &workers[i]) != 0)
+		{
+			fprintf(stderr, "bytea_exif_extract: could not create thread\n");
+			return 1;
+		}
+	}
+	for (int i = 0; i < nworkers; i++)
+	{
+		pthread_join(workers[i].thread, NULL);
+		free(workers[i].out.data);
+		free(workers[i].deque.items);
+		pthread_mutex_destroy(&workers[i].deque.lock);
+	}
+	free(workers);
+	free(visited);
+
+	if (binary_format)
+		fwrite("\377\377", 1, 2, output);
+	if (fflush(output) != 0 || failed)
+	{
+		fprintf(stderr, "bytea_exif_extract: could not write output: %s\n", strerror(errno));
+		return 1;
+	}
+	if (outname)
+		fclose(output);
+	return 0;
+}
@@ -0,0 +1,230 @@
+/*-------------------------------------------------------------------------
+ *
+ * EXIF data extractor for PotgreSQL bytea data
+ * Slice reader for toasted bytea values as a source for the core
+ *
+ * (c) 2025, mkgrgis
+ *
+ * IDENTIFICATION
+ *		bytea_exif_segment.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "bytea_exif.h"
+
+#include "fmgr.h"
+#include "utils/memutils.h"
+#if PG_VERSION_NUM >= 130000
+	#include "access/detoast.h"
+#else
+	#include "access/tuptoaster.h"
+#endif
+#if PG_VERSION_NUM >= 160000
+	#include "varatt.h"
+#endif
+
+/*
+ * Segment tables of external values, shared by all readers of the same value
+ * in a transaction, for example by EXIF and XMP functions for one row.
+ * A toast pointer identifies not changed data, the tables are in a child of
+ * TopTransactionContext and are forgotten at the end of the transaction.
+ */
+#define EXIF_SEGMENT_CACHE_SIZE	4
+
+typedef struct ExifSegmentCacheEntry
+{
+	struct varatt_external	key;		/* toast pointer of the value */
+	int						pins;		/* readers of the table */
+	ExifJpegSegments		segments;
+} ExifSegmentCacheEntry;
+
+static MemoryContext exif_segment_cxt = NULL;
+static ExifSegmentCacheEntry exif_segment_cache[EXIF_SEGMENT_CACHE_SIZE];
+static int exif_segment_cache_next = 0;
+
+static const unsigned char *
+exif_reader_source_fetch(void *arg, int64_t off, int32_t len)
+{
+	return exif_reader_fetch((ExifByteaReader *) arg, off, len);
+}
+
+static void *
+exif_reader_segments_grow(void *ptr, size_t size)
+{
+	return ptr != NULL ? repalloc(ptr, size) : palloc(size);
+}
+
+static void *
+exif_segment_cache_grow(void *ptr, size_t size)
+{
+	return ptr != NULL ? repalloc(ptr, size) : MemoryContextAlloc(exif_segment_cxt, size);
+}
+
+static void
+exif_segment_cache_reset(void *arg)
+{
+	exif_segment_cxt = NULL;
+	memset(exif_segment_cache, 0, sizeof(exif_segment_cache));
+	exif_segment_cache_next = 0;
+}
+
+/*
+ * exif_segment_cache_get
+ * Returns pinned cache entry for an external value, a new entry replaces
+ * not pinned one. Returns NULL if all of entries are pinned.
+ */
+static ExifSegmentCacheEntry *
+exif_segment_cache_get(struct varlena *v)
+{
+	struct varatt_external	key;
+	ExifSegmentCacheEntry  *e;
+
+	VARATT_EXTERNAL_GET_POINTER(key, v);
+	if (exif_segment_cxt == NULL)
+	{
+		MemoryContextCallback *cb;
+
+		exif_segment_cxt = AllocSetContextCreate(TopTransactionContext,
+												 "bytea_exif segments",
+												 ALLOCSET_SMALL_SIZES);
+		cb = MemoryContextAlloc(exif_segment_cxt, sizeof(MemoryContextCallback));
+		cb->func = exif_segment_cache_reset;
+		cb->arg = NULL;
+		MemoryContextRegisterResetCallback(exif_segment_cxt, cb);
+	}
+
+	for (int i = 0; i < EXIF_SEGMENT_CACHE_SIZE; i++)
+	{
+		e = &exif_segment_cache[i];
+		if (e->segments.grow != NULL && memcmp(&e->key, &key, sizeof(key)) == 0)
+		{
+			e->pins++;
+			return e;
+		}
+	}
+
+	for (int i = 0; i < EXIF_SEGMENT_CACHE_SIZE; i++)
+	{
+		e = &exif_segment_cache[exif_segment_cache_next];
+		exif_segment_cache_next = (exif_segment_cache_next + 1) % EXIF_SEGMENT_CACHE_SIZE;
+		if (e->pins > 0)
+			continue;
+		if (e->segments.segs != NULL)
+			pfree(e->segments.segs);
+		memset(e, 0, sizeof(ExifSegmentCacheEntry));
+		e->key = key;
+		e->pins = 1;
+		e->segments.grow = exif_segment_cache_grow;
+		return e;
+	}
+	return NULL;
+}
+
+/*
+ * exif_reader_init
+ * Prepares a reader for a bytea datum. Not toasted values are read directly,
+ * for external or compressed values only the fetched slices are detoasted.
+ */
+void
+exif_reader_init(ExifByteaReader *r, Datum d)
+{
+	struct varlena *v = (struct varlena *) DatumGetPointer(d);
+
+	memset(r, 0, sizeof(ExifByteaReader));
+	r->datum = d;
+	if (VARATT_IS_EXTERNAL(v) || VARATT_IS_COMPRESSED(v))
+	{
+		r->data = NULL;
+		r->size = toast_raw_datum_size(d) - VARHDRSZ;
+	}
+	else
+	{
+		r->data = (const unsigned char *) VARDATA_ANY(v);
+		r->size = VARSIZE_ANY_EXHDR(v);
+	}
+	r->segments.grow = exif_reader_segments_grow;
+	r->src.fetch = exif_reader_source_fetch;
+	r->src.arg = r;
+	r->src.size = r->size;
+	r->src.segments = &r->segments;
+
+	/* segments of external values are read by slices, the table is shared */
+	if (VARATT_IS_EXTERNAL_ONDISK(v))
+	{
+		r->cached = exif_segment_cache_get(v);
+		if (r->cached != NULL)
+			r->src.segments = &r->cached->segments;
+	}
+}
+
+/*
+ * exif_reader_fetch
+ * Returns pointer to len bytes from offset off or NULL if the data is shorter.
+ * A pointer returned by previous call can be invalid after this call.
+ */
+const unsigned char *
+exif_reader_fetch(ExifByteaReader *r, int64 off, int32 len)
+{
+	int32	wlen;
+
+	if (off < 0 || len < 0 || off + len > r->size)
+		return NULL;
+	if (r->data != NULL)
+		return r->data + off;
+
+	if (r->win != NULL && off >= r->win_off && off + len <= r->win_off + r->win_len)
+		return (const unsigned char *) VARDATA_ANY(r->win) + (off - r->win_off);
+
+	if (r->win != NULL)
+		pfree(r->win);
+	wlen = Max(len, EXIF_READER_WINDOW);
+	if (off + wlen > r->size)
+		wlen = r->size - off;
+	r->win = DatumGetByteaPSlice(r->datum, (int32) off, wlen);
+	r->win_off = off;
+	r->win_len = VARSIZE_ANY_EXHDR(r->win);
+	if (r->win_len < len)
+		return NULL;
+	return (const unsigned char *) VARDATA_ANY(r->win);
+}
+
+void
+exif_reader_free(ExifByteaReader *r)
+{
+	if (r->win != NULL)
+		pfree(r->win);
+	r->win = NULL;
+	if (r->segments.segs != NULL)
+		pfree(r->segments.segs);
+	memset(&r->segments, 0, sizeof(ExifJpegSegments));
+	/* the cache can be already reset at the end of the transaction */
+	if (r->cached != NULL && exif_segment_cxt != NULL)
+		r->cached->pins--;
+	r->cached = NULL;
+}
+
+/*
+ * exif_jpeg_next_segment
+ * Iterates JPEG segment table of the reader, *i must be 0 for first call.
+ * The table is extended by the core only up to the requested segment.
+ */
+bool
+exif_jpeg_next_segment(ExifByteaReader *r, int *i, ExifJpegSegment *seg)
+{
+	if (!exif_core_jpeg_segment(&r->src, *i, seg))
+		return false;
+	(*i)++;
+	return true;
+}
+
+/*
+ * exif_is_jpeg
+ * Checks SOI marker at the begin of the data.
+ */
+bool
+exif_is_jpeg(ExifByteaReader *r)
+{
+	return exif_core_is_jpeg(&r->src) != 0;
+}
@@ -0,0 +1,459 @@
+/*-------------------------------------------------------------------------
+ *
+ * EXIF data extractor for PotgreSQL bytea data
+ * Trigger function filling many columns from one EXIF data parse
+ *
+ * (c) 2025, mkgrgis
+ *
+ * IDENTIFICATION
+ *		bytea_exif_trigger.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "bytea_exif.h"
+
+#include <float.h>
+
+#include "access/htup_details.h"
+#include "catalog/pg_type.h"
+#include "commands/trigger.h"
+#include "executor/spi.h"
+#include "fmgr.h"
+#include "mb/pg_wchar.h"
+#if PG_VERSION_NUM >= 160000
+#include "nodes/miscnodes.h"
+#endif
+#include "utils/builtins.h"
+#include "utils/datum.h"
+#include "utils/lsyscache.h"
+#include "utils/rel.h"
+
+#if PG_VERSION_NUM < 110000 && !defined(TupleDescAttr)
+#define TupleDescAttr(tupdesc, i) ((tupdesc)->attrs[(i)])
+#endif
+
+Datum bytea_exif_fill_columns(PG_FUNCTION_ARGS);
+
+PG_FUNCTION_INFO_V1(bytea_exif_fill_columns);
+
+/* One "Tag=column" trigger argument */
+typedef struct ExifColumnMap
+{
+	char	   *tagname;
+	int			attnum;
+	Oid			atttypid;
+	int32		atttypmod;
+	FmgrInfo	typinput;
+	Oid			typioparam;
+} ExifColumnMap;
+
+/* Parsed trigger arguments, kept in fn_extra for all rows of a statement */
+typedef struct ExifTriggerCache
+{
+	Oid				tgoid;
+	int				img_attnum;
+	int				nmaps;
+	ExifColumnMap	maps[FLEXIBLE_ARRAY_MEMBER];
+} ExifTriggerCache;
+
+/*
+ * exif_entry_double
+ * Returns first component of numeric EXIF value as double.
+ */
+static bool
+exif_entry_double(ExifEntry *ee, ExifByteOrder o, double *result)
+{
+	unsigned	size = exif_format_get_size(ee->format);
+
+	if (ee->data == NULL || ee->components == 0 || size == 0 || ee->size < size)
+		return false;
+	switch (ee->format)
+	{
+		case EXIF_FORMAT_BYTE:
+			*result = ee->data[0];
+			return true;
+		case EXIF_FORMAT_SBYTE:
+			*result = (signed char) ee->data[0];
+			return true;
+		case EXIF_FORMAT_SHORT:
+			*result = exif_get_short(ee->data, o);
+			return true;
+		case EXIF_FORMAT_SSHORT:
+			*result = exif_get_sshort(ee->data, o);
+			return true;
+		case EXIF_FORMAT_LONG:
+			*result = exif_get_long(ee->data, o);
+			return true;
+		case EXIF_FORMAT_SLONG:
+			*result = exif_get_slong(ee->data, o);
+			return true;
+		case EXIF_FORMAT_RATIONAL:
+		{
+			ExifRational r = exif_get_rational(ee->data, o);
+
+			if (r.denominator == 0)
+				return false;
+			*result = (double) r.numerator / (double) r.denominator;
+			return true;
+		}
+		case EXIF_FORMAT_SRATIONAL:
+		{
+			ExifSRational r = exif_get_srational(ee->data, o);
+
+			if (r.denominator == 0)
+				return false;
+			*result = (double) r.numerator / (double) r.denominator;
+			return true;
+		}
+		case EXIF_FORMAT_ASCII:
+		{
+			char		buf[64];
+			char	   *end;
+			unsigned	n = Min(ee->size, sizeof(buf) - 1);
+
+			memcpy(buf, ee->data, n);
+			buf[n] = '\0';
+			*result = strtod(buf, &end);
+			return end != buf;
+		}
+		default:
+			return false;
+	}
+}
+
+#if PG_VERSION_NUM < 160000
+/*
+ * exif_number_fits
+ * Checks the range of integer types and precision of numeric typmod before
+ * the input function, which throws ERROR for such values.
+ */
+static bool
+exif_number_fits(double d, Oid atttypid, int32 atttypmod)
+{
+	switch (atttypid)
+	{
+		case INT2OID:
+			return rint(d) >= PG_INT16_MIN && rint(d) <= PG_INT16_MAX;
+		case INT4OID:
+			return rint(d) >= PG_INT32_MIN && rint(d) <= PG_INT32_MAX;
+		case INT8OID:
+			/* INT64_MAX is rounded up to 2^63 as double, -2^63 is INT64_MIN */
+			return rint(d) >= (double) PG_INT64_MIN && rint(d) < -(double) PG_INT64_MIN;
+		case FLOAT4OID:
+			return fabs(d) <= FLT_MAX && (d == 0 || fabs(d) >= FLT_MIN);
+		case NUMERICOID:
+			if (atttypmod >= (int32) VARHDRSZ)
+			{
+				int32		tm = atttypmod - VARHDRSZ;
+				int			precision = (tm >> 16) & 0xffff;
+				int			scale = ((tm & 0x7ff) ^ 1024) - 1024;
+				double		m = pow(10.0, scale);
+
+				return fabs(rint(d * m) / m) < pow(10.0, precision - scale);
+			}
+			return true;
+		default:
+			return true;
+	}
+}
+
+/*
+ * exif_type_checked
+ * Returns true for column types with checks here, the input function is not
+ * called for a value which throws ERROR.
+ */
+static bool
+exif_type_checked(Oid atttypid)
+{
+	switch (atttypid)
+	{
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+		case FLOAT4OID:
+		case FLOAT8OID:
+		case NUMERICOID:
+		case TEXTOID:
+		case VARCHAROID:
+		case BPCHAROID:
+		case BOOLOID:
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+			return true;
+		default:
+			return false;
+	}
+}
+#endif
+
+/*
+ * exif_input
+ * Converts text to a value of the column type. Returns false instead of
+ * ERROR if the text is not correct for the type or does not fit the typmod.
+ */
+static bool
+exif_input(ExifColumnMap *map, char *str, Datum *result)
+{
+#if PG_VERSION_NUM >= 160000
+	ErrorSaveContext escontext = {T_ErrorSaveContext};
+
+	return InputFunctionCallSafe(&map->typinput, str, map->typioparam,
+								 map->atttypmod, (Node *) &escontext, result);
+#else
+	switch (map->atttypid)
+	{
+		case VARCHAROID:
+		case BPCHAROID:
+			if (map->atttypmod >= (int32) VARHDRSZ &&
+				pg_mbstrlen(str) > map->atttypmod - (int32) VARHDRSZ)
+				return false;
+			break;
+		case BOOLOID:
+		{
+			bool		b;
+
+			if (!parse_bool(str, &b))
+				return false;
+			*result = BoolGetDatum(b);
+			return true;
+		}
+		default:
+			/* numbers are checked by exif_number_fits, text always fits */
+			break;
+	}
+	*result = InputFunctionCall(&map->typinput, str, map->typioparam, map->atttypmod);
+	return true;
+#endif
+}
+
+/*
+ * exif_entry_to_column
+ * Converts EXIF entry to a value of the column type. Returns false if the
+ * entry can not be presented by the type.
+ */
+static bool
+exif_entry_to_column(ExifData *edata, ExifEntry *ee, ExifColumnMap *map, Datum *result)
+{
+	char		buf[EXIF_CORE_VALUE_LEN];
+
+	switch (map->atttypid)
+	{
+		case TIMESTAMPTZOID:
+		case TIMESTAMPOID:
+		{
+			TimestampTz ts;
+
+			if (ee->tag != EXIF_TAG_DATE_TIME &&
+				ee->tag != EXIF_TAG_DATE_TIME_ORIGINAL &&
+				ee->tag != EXIF_TAG_DATE_TIME_DIGITIZED)
+				return false;
+			/* timestamp without time zone gets local time as is */
+			if (!exif_data_datetime(edata, ee->tag, map->atttypid == TIMESTAMPTZOID, &ts))
+				return false;
+			*result = TimestampTzGetDatum(ts);
+			return true;
+		}
+		case INT2OID:
+		case INT4OID:
+		case INT8OID:
+		case FLOAT4OID:
+		case FLOAT8OID:
+		case NUMERICOID:
+		{
+			double		d;
+
+			if (!exif_entry_double(ee, exif_data_get_byte_order(edata), &d) || !isfinite(d))
+				return false;
+#if PG_VERSION_NUM < 160000
+			if (!exif_number_fits(d, map->atttypid, map->atttypmod))
+				return false;
+#endif
+			if (map->atttypid == INT2OID || map->atttypid == INT4OID || map->atttypid == INT8OID)
+				snprintf(buf, sizeof(buf), "%.0f", rint(d));
+			else
+				snprintf(buf, sizeof(buf), "%.15g", d);
+			break;
+		}
+		default:
+			exif_entry_get_value(ee, buf, sizeof(buf));
+			/* the text is a part of the column value */
+			if (!pg_verifymbstr(buf, strlen(buf), true))
+				return false;
+			break;
+	}
+
+	return exif_input(map, buf, result);
+}
+
+/*
+ * exif_trigger_cache
+ * Parses and checks trigger arguments on first call of the trigger in a
+ * statement. The result is kept in fn_extra for next rows.
+ */
+static ExifTriggerCache *
+exif_trigger_cache(FunctionCallInfo fcinfo, TriggerData *trigdata)
+{
+	ExifTriggerCache *cache = (ExifTriggerCache *) fcinfo->flinfo->fn_extra;
+	Trigger		   *trigger = trigdata->tg_trigger;
+	TupleDesc		tupdesc = trigdata->tg_relation->rd_att;
+	MemoryContext	oldcontext;
+	int				img_attnum;
+	int				nmaps;
+
+	if (cache != NULL && cache->tgoid == trigger->tgoid)
+		return cache;
+
+	if (trigger->tgnargs < 2)
+		ereport(ERROR,
+			(errcode(ERRCODE_E_R_I_E_TRIGGER_PROTOCOL_VIOLATED),
+			 errmsg("bytea_exif_fill_columns: image column and at least one 'Tag=column' argument are required")));
+
+	img_attnum = SPI_fnumber(tupdesc, trigger->tgargs[0]);
+	if (img_attnum <= 0)
+		ereport(ERROR,
+			(errcode(ERRCODE_UNDEFINED_COLUMN),
+			 errmsg("bytea_exif_fill_columns: column \"%s\" does not exist", trigger->tgargs[0])));
+	if (SPI_gettypeid(tupdesc, img_attnum) != BYTEAOID)
+		ereport(ERROR,
+			(errcode(ERRCODE_DATATYPE_MISMATCH),
+			 errmsg("bytea_exif_fill_columns: column \"%s\" is not bytea", trigger->tgargs[0])));
+
+	oldcontext = MemoryContextSwitchTo(fcinfo->flinfo->fn_mcxt);
+	nmaps = trigger->tgnargs - 1;
+	cache = (ExifTriggerCache *) palloc(offsetof(ExifTriggerCache, maps) + sizeof(ExifColumnMap) * nmaps);
+	cache->img_attnum = img_attnum;
+	cache->nmaps = nmaps;
+	for (int i = 0; i < nmaps; i++)
+	{
+		ExifColumnMap *map = &cache->maps[i];
+		char	   *arg = pstrdup(trigger->tgargs[i + 1]);
+		char	   *eq = strchr(arg, '=');
+		Oid			typinput;
+
+		if (eq == NULL || eq == arg || eq[1] == '\0')
+			ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("bytea_exif_fill_columns: invalid argument \"%s\"", arg),
+				 errhint("Arguments after image column must be like 'Model=camera_model'")));
+		*eq = '\0';
+		map->tagname = arg;
+		if (!exif_tag_from_name(arg))
+			ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("bytea_exif_fill_columns: tag name \"%s\" is not correct", arg),
+				 errhint("Please read EXIF specification and search for \"%s\"", arg)));
+		map->attnum = SPI_fnumber(tupdesc, eq + 1);
+		if (map->attnum <= 0 || map->attnum == img_attnum)
+			ereport(ERROR,
+				(errcode(ERRCODE_UNDEFINED_COLUMN),
+				 errmsg("bytea_exif_fill_columns: column \"%s\" does not exist or is the image column", eq + 1)));
+		map->atttypid = TupleDescAttr(tupdesc, map->attnum - 1)->atttypid;
+		map->atttypmod = TupleDescAttr(tupdesc, map->attnum - 1)->atttypmod;
+#if PG_VERSION_NUM < 160000
+		/* there is no soft error input before PostgreSQL 16 */
+		if (!exif_type_checked(map->atttypid))
+			ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("bytea_exif_fill_columns: type %s of column \"%s\" is not supported", format_type_be(map->atttypid), eq + 1),
+				 errhint("Before PostgreSQL 16 only numbers, text, varchar, char, bool, timestamp and timestamptz columns are supported")));
+#endif
+		getTypeInputInfo(map->atttypid, &typinput, &map->typioparam);
+		fmgr_info_cxt(typinput, &map->typinput, fcinfo->flinfo->fn_mcxt);
+	}
+	MemoryContextSwitchTo(oldcontext);
+
+	cache->tgoid = trigger->tgoid;
+	fcinfo->flinfo->fn_extra = cache;
+	return cache;
+}
+
+/*
+ * bytea_exif_fill_columns
+ * BEFORE INSERT OR UPDATE row trigger. First argument is bytea column with
+ * image, other arguments are 'Tag=column' pairs. EXIF data is parsed once for
+ * all columns. UPDATE without change of the image column is skipped.
+ */
+Datum
+bytea_exif_fill_columns(PG_FUNCTION_ARGS)
+{
+	TriggerData	   *trigdata = (TriggerData *) fcinfo->context;
+	ExifTriggerCache *cache;
+	TupleDesc		tupdesc;
+	HeapTuple		tuple;
+	int				img_attnum;
+	Datum			img;
+	bool			img_isnull;
+	Datum		   *values;
+	bool		   *nulls;
+	bool		   *replace;
+	ExifData	   *edata = NULL;
+
+	if (!CALLED_AS_TRIGGER(fcinfo))
+		ereport(ERROR,
+			(errcode(ERRCODE_E_R_I_E_TRIGGER_PROTOCOL_VIOLATED),
+			 errmsg("bytea_exif_fill_columns: not called by trigger manager")));
+	if (!TRIGGER_FIRED_FOR_ROW(trigdata->tg_event) ||
+		!TRIGGER_FIRED_BEFORE(trigdata->tg_event) ||
+		TRIGGER_FIRED_BY_DELETE(trigdata->tg_event))
+		ereport(ERROR,
+			(errcode(ERRCODE_E_R_I_E_TRIGGER_PROTOCOL_VIOLATED),
+			 errmsg("bytea_exif_fill_columns: must be fired before insert or update for each row")));
+
+	tupdesc = trigdata->tg_relation->rd_att;
+	tuple = TRIGGER_FIRED_BY_UPDATE(trigdata->tg_event) ? trigdata->tg_newtuple : trigdata->tg_trigtuple;
+	cache = exif_trigger_cache(fcinfo, trigdata);
+	img_attnum = cache->img_attnum;
+
+	img = heap_getattr(tuple, img_attnum, tupdesc, &img_isnull);
+
+	/* image is not changed, EXIF columns are not recalculated */
+	if (TRIGGER_FIRED_BY_UPDATE(trigdata->tg_event))
+	{
+		bool		old_isnull;
+		Datum		old = heap_getattr(trigdata->tg_trigtuple, img_attnum, tupdesc, &old_isnull);
+
+		if (img_isnull == old_isnull &&
+			(img_isnull || datumIsEqual(img, old, false, -1)))
+			return PointerGetDatum(tuple);
+	}
+
+	if (!img_isnull && exif_datum_size(img) > 0)
+		edata = exif_data_from_datum(img);
+
+	values = (Datum *) palloc0(sizeof(Datum) * tupdesc->natts);
+	nulls = (bool *) palloc(sizeof(bool) * tupdesc->natts);
+	replace = (bool *) palloc0(sizeof(bool) * tupdesc->natts);
+	memset(nulls, true, sizeof(bool) * tupdesc->natts);
+
+	/* edata is malloc'd by libexif, it is freed on ERROR too */
+	PG_TRY();
+	{
+		for (int i = 0; i < cache->nmaps; i++)
+		{
+			ExifColumnMap *map = &cache->maps[i];
+			int			k = map->attnum - 1;
+			ExifEntry  *ee;
+
+			replace[k] = true;
+			if (edata == NULL)
+				continue;
+			ee = exif_core_entry_by_name(edata, map->tagname);
+			if (ee != NULL && exif_entry_to_column(edata, ee, map, &values[k]))
+				nulls[k] = false;
+		}
+	}
+	PG_CATCH();
+	{
+		if (edata != NULL)
+			exif_data_free (edata);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+	if (edata != NULL)
+		exif_data_free (edata);
+
+	tuple = heap_modify_tuple(tuple, tupdesc, values, nulls, replace);
+	return PointerGetDatum(tuple);
+}
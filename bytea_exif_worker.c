@@ -0,0 +1,559 @@
+/*-------------------------------------------------------------------------
+ *
+ * EXIF data extractor for PotgreSQL bytea data
+ * Background worker for asynchronous EXIF extraction into a sidecar table
+ *
+ * (c) 2025, mkgrgis
+ *
+ * IDENTIFICATION
+ *		bytea_exif_worker.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "bytea_exif.h"
+
+#include "access/xact.h"
+#include "catalog/pg_class.h"
+#include "catalog/pg_type.h"
+#include "executor/spi.h"
+#include "fmgr.h"
+#include "lib/stringinfo.h"
+#include "miscadmin.h"
+#include "pgstat.h"
+#include "postmaster/bgworker.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "tcop/tcopprot.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/resowner.h"
+#include "utils/snapmgr.h"
+
+extern PGDLLEXPORT void bytea_exif_worker_main(Datum main_arg);
+
+/* GUC variables */
+static int	exif_worker_count = 0;
+static char *exif_worker_database = NULL;
+static int	exif_worker_naptime = 10;
+static int	exif_worker_batch_size = 100;
+static char *exif_worker_queue_table = NULL;
+static char *exif_worker_sidecar_table = NULL;
+
+/* flag set by signal handler */
+static volatile sig_atomic_t got_sighup = false;
+
+/* One claimed queue entry */
+typedef struct ExifQueueEntry
+{
+	Oid			relid;
+	char	   *attname;
+	char	   *pk;
+} ExifQueueEntry;
+
+static void
+exif_worker_sighup(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	got_sighup = true;
+	SetLatch(MyLatch);
+	errno = save_errno;
+}
+
+/*
+ * exif_worker_init
+ * Defines GUC variables and registers background workers if the library
+ * is loaded by shared_preload_libraries. Called from _PG_init.
+ */
+void
+exif_worker_init(void)
+{
+	BackgroundWorker worker;
+	int			i;
+
+	DefineCustomIntVariable("bytea_exif.worker_count",
+							"Number of background workers for EXIF extraction from the queue table.",
+							"0 disables the background workers.",
+							&exif_worker_count,
+							0,
+							0,
+							64,
+							PGC_POSTMASTER,
+							0,
+							NULL, NULL, NULL);
+
+	DefineCustomStringVariable("bytea_exif.worker_database",
+							   "Database the background workers connect to.",
+							   NULL,
+							   &exif_worker_database,
+							   "postgres",
+							   PGC_POSTMASTER,
+							   0,
+							   NULL, NULL, NULL);
+
+	DefineCustomIntVariable("bytea_exif.worker_naptime",
+							"Duration between checks of empty queue table.",
+							NULL,
+							&exif_worker_naptime,
+							10,
+							1,
+							INT_MAX / 1000,
+							PGC_SIGHUP,
+							GUC_UNIT_S,
+							NULL, NULL, NULL);
+
+	DefineCustomIntVariable("bytea_exif.worker_batch_size",
+							"Number of queue entries processed by a background worker in one transaction.",
+							NULL,
+							&exif_worker_batch_size,
+							100,
+							1,
+							100000,
+							PGC_SIGHUP,
+							0,
+							NULL, NULL, NULL);
+
+	DefineCustomStringVariable("bytea_exif.worker_queue_table",
+							   "Queue table of background workers.",
+							   "Name is resolved in the schema of bytea_exif extension if not qualified.",
+							   &exif_worker_queue_table,
+							   "bytea_exif_queue",
+							   PGC_SIGHUP,
+							   0,
+							   NULL, NULL, NULL);
+
+	DefineCustomStringVariable("bytea_exif.worker_sidecar_table",
+							   "Sidecar table for EXIF data extracted by background workers.",
+							   "Name is resolved in the schema of bytea_exif extension if not qualified.",
+							   &exif_worker_sidecar_table,
+							   "bytea_exif_sidecar",
+							   PGC_SIGHUP,
+							   0,
+							   NULL, NULL, NULL);
+
+	if (!process_shared_preload_libraries_in_progress)
+		return;
+
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS | BGWORKER_BACKEND_DATABASE_CONNECTION;
+	worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
+	worker.bgw_restart_time = 10;
+	sprintf(worker.bgw_library_name, "bytea_exif");
+	sprintf(worker.bgw_function_name, "bytea_exif_worker_main");
+#if PG_VERSION_NUM >= 110000
+	snprintf(worker.bgw_type, BGW_MAXLEN, "bytea_exif worker");
+#endif
+	worker.bgw_notify_pid = 0;
+
+	for (i = 1; i <= exif_worker_count; i++)
+	{
+		snprintf(worker.bgw_name, BGW_MAXLEN, "bytea_exif worker %d", i);
+		worker.bgw_main_arg = Int32GetDatum(i);
+		RegisterBackgroundWorker(&worker);
+	}
+}
+
+/*
+ * exif_worker_pk_column
+ * Returns name of single column primary key of a relation and sets its type
+ * or returns NULL.
+ */
+static char *
+exif_worker_pk_column(Oid relid, Oid *pktype)
+{
+	Oid			argtypes[1] = {OIDOID};
+	Datum		values[1];
+	bool		isnull;
+	int			ret;
+
+	values[0] = ObjectIdGetDatum(relid);
+	ret = SPI_execute_with_args("SELECT a.attname, a.atttypid"
+								"  FROM pg_catalog.pg_index i"
+								"  JOIN pg_catalog.pg_attribute a"
+								"    ON a.attrelid = i.indrelid AND a.attnum = i.indkey[0]"
+								" WHERE i.indrelid = $1 AND i.indisprimary AND i.indnatts = 1",
+								1, argtypes, values, NULL, true, 1);
+	if (ret != SPI_OK_SELECT || SPI_processed != 1)
+		return NULL;
+	*pktype = DatumGetObjectId(SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 2, &isnull));
+	return SPI_getvalue(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1);
+}
+
+/*
+ * exif_worker_table
+ * Resolves a table name from GUC like regclass input and returns the name
+ * quoted for SQL or NULL if there is no such table.
+ */
+static char *
+exif_worker_table(const char *name)
+{
+	Oid			argtypes[1] = {TEXTOID};
+	Datum		values[1];
+	bool		isnull;
+	Oid			relid;
+	char		relkind;
+	int			ret;
+
+	values[0] = CStringGetTextDatum(name);
+	ret = SPI_execute_with_args("SELECT pg_catalog.to_regclass($1)::oid",
+								1, argtypes, values, NULL, true, 1);
+	if (ret != SPI_OK_SELECT || SPI_processed != 1)
+		return NULL;
+	relid = DatumGetObjectId(SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc, 1, &isnull));
+	if (isnull)
+		return NULL;
+	relkind = get_rel_relkind(relid);
+	if (relkind != RELKIND_RELATION && relkind != RELKIND_PARTITIONED_TABLE)
+		return NULL;
+	return quote_qualified_identifier(get_namespace_name(get_rel_namespace(relid)),
+									  get_rel_name(relid));
+}
+
+/*
+ * exif_worker_upsert
+ * Extracts EXIF data from image column of all rows of one relation with
+ * pointed primary key values and upserts the results into sidecar table.
+ * Primary key values are converted to the key type once, so the primary
+ * key index can be used.
+ */
+static void
+exif_worker_upsert(ExifQueueEntry *e, Datum *pks, int npks, const char *sidecar)
+{
+	Oid			argtypes[2] = {OIDOID, TEXTARRAYOID};
+	Datum		values[2];
+	char	   *relname = get_rel_name(e->relid);
+	char	   *pkname;
+	Oid			pktype;
+	StringInfoData sql;
+	int			ret;
+
+	if (relname == NULL)
+	{
+		elog(LOG, "bytea_exif worker: relation %u from the queue does not exist", e->relid);
+		return;
+	}
+	if (get_attnum(e->relid, e->attname) == InvalidAttrNumber)
+	{
+		elog(LOG, "bytea_exif worker: column \"%s\" of relation \"%s\" does not exist", e->attname, relname);
+		return;
+	}
+	pkname = exif_worker_pk_column(e->relid, &pktype);
+	if (pkname == NULL)
+	{
+		elog(WARNING, "bytea_exif worker: relation \"%s\" has no single column primary key", relname);
+		return;
+	}
+
+	initStringInfo(&sql);
+	appendStringInfo(&sql,
+					 "INSERT INTO %s AS s (relid, pk, exif, datetime_original, point)"
+					 " SELECT $1, t.%s::text,"
+					 " bytea_get_exif_jsonb(t.%s),"
+					 " bytea_get_exif_datetime_original(t.%s),"
+					 " bytea_get_exif_point(t.%s)"
+					 " FROM %s t WHERE t.%s = ANY ($2::%s[])"
+					 " ON CONFLICT (relid, pk) DO UPDATE SET"
+					 " exif = EXCLUDED.exif,"
+					 " datetime_original = EXCLUDED.datetime_original,"
+					 " point = EXCLUDED.point,"
+					 " error = NULL,"
+					 " updated = pg_catalog.now()",
+					 sidecar,
+					 quote_identifier(pkname),
+					 quote_identifier(e->attname),
+					 quote_identifier(e->attname),
+					 quote_identifier(e->attname),
+					 quote_qualified_identifier(get_namespace_name(get_rel_namespace(e->relid)), relname),
+					 quote_identifier(pkname),
+					 format_type_be(pktype));
+
+	values[0] = ObjectIdGetDatum(e->relid);
+	values[1] = PointerGetDatum(construct_array(pks, npks, TEXTOID, -1, false, 'i'));
+	ret = SPI_execute_with_args(sql.data, 2, argtypes, values, NULL, false, 0);
+	if (ret != SPI_OK_INSERT)
+		elog(ERROR, "bytea_exif worker: cannot upsert into %s: error code %d", sidecar, ret);
+	pfree(sql.data);
+}
+
+/*
+ * exif_worker_error
+ * Records error of a queue entry in the sidecar table. Old extracted values
+ * of the image are cleared, they are not actual for changed image.
+ */
+static void
+exif_worker_error(ExifQueueEntry *e, Datum pk, const char *error, const char *sidecar)
+{
+	Oid			argtypes[3] = {OIDOID, TEXTOID, TEXTOID};
+	Datum		values[3];
+	StringInfoData sql;
+	int			ret;
+
+	initStringInfo(&sql);
+	appendStringInfo(&sql,
+					 "INSERT INTO %s AS s (relid, pk, error) VALUES ($1, $2, $3)"
+					 " ON CONFLICT (relid, pk) DO UPDATE SET"
+					 " exif = NULL,"
+					 " datetime_original = NULL,"
+					 " point = NULL,"
+					 " error = EXCLUDED.error,"
+					 " updated = pg_catalog.now()",
+					 sidecar);
+	values[0] = ObjectIdGetDatum(e->relid);
+	values[1] = pk;
+	values[2] = CStringGetTextDatum(error);
+	ret = SPI_execute_with_args(sql.data, 3, argtypes, values, NULL, false, 0);
+	if (ret != SPI_OK_INSERT)
+		elog(ERROR, "bytea_exif worker: cannot insert into %s: error code %d", sidecar, ret);
+	pfree(sql.data);
+}
+
+/*
+ * exif_worker_subxact
+ * Calls exif_worker_upsert or exif_worker_error if error is not NULL in
+ * a subtransaction. Returns NULL or data of an error of the subtransaction.
+ */
+static ErrorData *
+exif_worker_subxact(ExifQueueEntry *e, Datum *pks, int npks, const char *error, const char *sidecar)
+{
+	MemoryContext oldcontext = CurrentMemoryContext;
+	ResourceOwner oldowner = CurrentResourceOwner;
+	ErrorData  *edata = NULL;
+
+	BeginInternalSubTransaction(NULL);
+	MemoryContextSwitchTo(oldcontext);
+	PG_TRY();
+	{
+		if (error == NULL)
+			exif_worker_upsert(e, pks, npks, sidecar);
+		else
+			exif_worker_error(e, pks[0], error, sidecar);
+		ReleaseCurrentSubTransaction();
+		MemoryContextSwitchTo(oldcontext);
+		CurrentResourceOwner = oldowner;
+	}
+	PG_CATCH();
+	{
+		MemoryContextSwitchTo(oldcontext);
+		edata = CopyErrorData();
+		FlushErrorState();
+		RollbackAndReleaseCurrentSubTransaction();
+		MemoryContextSwitchTo(oldcontext);
+		CurrentResourceOwner = oldowner;
+	}
+	PG_END_TRY();
+	return edata;
+}
+
+/*
+ * exif_worker_group
+ * Upserts all entries of one relation and column by one statement. After an
+ * error every entry is processed alone, hence one broken image or primary
+ * key value can not drop other entries. An error of an entry is recorded in
+ * the sidecar table, only if this is not possible the entry is dropped with
+ * a warning, so broken relations can not block the queue.
+ */
+static void
+exif_worker_group(ExifQueueEntry *e, Datum *pks, int npks, const char *sidecar)
+{
+	ErrorData  *edata = exif_worker_subxact(e, pks, npks, NULL, sidecar);
+
+	if (edata == NULL)
+		return;
+	if (npks > 1)
+	{
+		FreeErrorData(edata);
+		edata = NULL;
+	}
+	for (int i = 0; i < npks; i++)
+	{
+		ErrorData  *rdata;
+
+		if (edata == NULL)
+			edata = exif_worker_subxact(e, &pks[i], 1, NULL, sidecar);
+		if (edata == NULL)
+			continue;
+		rdata = exif_worker_subxact(e, &pks[i], 1, edata->message, sidecar);
+		if (rdata != NULL)
+		{
+			ereport(WARNING,
+				(errcode(edata->sqlerrcode),
+				 errmsg("bytea_exif worker: queue entry \"%s\" of relation %u dropped",
+						TextDatumGetCString(pks[i]), e->relid),
+				 errdetail("%s", edata->message),
+				 errcontext("%s", rdata->message)));
+			FreeErrorData(rdata);
+		}
+		FreeErrorData(edata);
+		edata = NULL;
+	}
+}
+
+static int
+exif_queue_entry_cmp(const void *a, const void *b)
+{
+	const ExifQueueEntry *ea = (const ExifQueueEntry *) a;
+	const ExifQueueEntry *eb = (const ExifQueueEntry *) b;
+
+	if (ea->relid != eb->relid)
+		return ea->relid < eb->relid ? -1 : 1;
+	return strcmp(ea->attname, eb->attname);
+}
+
+/*
+ * exif_worker_batch
+ * Claims up to bytea_exif.worker_batch_size queue entries and processes them
+ * grouped by relation and column. Entries locked by other workers are skipped.
+ * Returns number of claimed entries.
+ */
+static uint64
+exif_worker_batch(void)
+{
+	Datum		values[1];
+	Oid			argtypes[1] = {INT4OID};
+	StringInfoData sql;
+	ExifQueueEntry *entries;
+	Datum	   *pks;
+	char	   *queue;
+	char	   *sidecar;
+	uint64		n, i, start;
+	int			ret;
+
+	SetCurrentStatementStartTimestamp();
+	StartTransactionCommand();
+	SPI_connect();
+	PushActiveSnapshot(GetTransactionSnapshot());
+
+	/* functions and default tables are resolved in the extension schema */
+	ret = SPI_execute("SELECT pg_catalog.set_config('search_path', pg_catalog.quote_ident(n.nspname), true)"
+					  "  FROM pg_catalog.pg_extension e"
+					  "  JOIN pg_catalog.pg_namespace n ON n.oid = e.extnamespace"
+					  " WHERE e.extname = 'bytea_exif'", false, 0);
+	if (ret != SPI_OK_SELECT || SPI_processed != 1)
+	{
+		elog(LOG, "bytea_exif worker: extension bytea_exif is not installed in database \"%s\"", exif_worker_database);
+		SPI_finish();
+		PopActiveSnapshot();
+		CommitTransactionCommand();
+		return 0;
+	}
+
+	/* a missing table is logged, the worker sleeps and checks it again */
+	queue = exif_worker_table(exif_worker_queue_table);
+	sidecar = exif_worker_table(exif_worker_sidecar_table);
+	if (queue == NULL || sidecar == NULL)
+	{
+		elog(LOG, "bytea_exif worker: %s table \"%s\" does not exist in database \"%s\"",
+			 queue == NULL ? "queue" : "sidecar",
+			 queue == NULL ? exif_worker_queue_table : exif_worker_sidecar_table,
+			 exif_worker_database);
+		SPI_finish();
+		PopActiveSnapshot();
+		CommitTransactionCommand();
+		return 0;
+	}
+
+	initStringInfo(&sql);
+	appendStringInfo(&sql,
+					 "DELETE FROM %s WHERE ctid = ANY (ARRAY("
+					 "SELECT ctid FROM %s LIMIT $1 FOR UPDATE SKIP LOCKED))"
+					 " RETURNING relid::oid, attname::text, pk",
+					 queue, queue);
+	pgstat_report_activity(STATE_RUNNING, sql.data);
+
+	values[0] = Int32GetDatum(exif_worker_batch_size);
+	ret = SPI_execute_with_args(sql.data, 1, argtypes, values, NULL, false, 0);
+	if (ret != SPI_OK_DELETE_RETURNING)
+		elog(ERROR, "bytea_exif worker: cannot read queue table %s: error code %d", queue, ret);
+
+	n = SPI_processed;
+	entries = (ExifQueueEntry *) palloc(sizeof(ExifQueueEntry) * Max(n, 1));
+	pks = (Datum *) palloc(sizeof(Datum) * Max(n, 1));
+	for (i = 0; i < n; i++)
+	{
+		HeapTuple	tuple = SPI_tuptable->vals[i];
+		TupleDesc	tupdesc = SPI_tuptable->tupdesc;
+		bool		isnull;
+
+		entries[i].relid = DatumGetObjectId(SPI_getbinval(tuple, tupdesc, 1, &isnull));
+		entries[i].attname = SPI_getvalue(tuple, tupdesc, 2);
+		entries[i].pk = SPI_getvalue(tuple, tupdesc, 3);
+		if (isnull || entries[i].attname == NULL)
+		{
+			entries[i].relid = InvalidOid;
+			entries[i].attname = "";
+		}
+	}
+	qsort(entries, n, sizeof(ExifQueueEntry), exif_queue_entry_cmp);
+
+	/* one statement for every relation and image column */
+	for (start = 0; start < n; start = i)
+	{
+		int			npks = 0;
+
+		for (i = start; i < n && exif_queue_entry_cmp(&entries[start], &entries[i]) == 0; i++)
+			if (entries[i].pk != NULL)
+				pks[npks++] = CStringGetTextDatum(entries[i].pk);
+		if (OidIsValid(entries[start].relid) && npks > 0)
+			exif_worker_group(&entries[start], pks, npks, sidecar);
+	}
+
+	SPI_finish();
+	PopActiveSnapshot();
+	CommitTransactionCommand();
+	pgstat_report_stat(false);
+	pgstat_report_activity(STATE_IDLE, NULL);
+	return n;
+}
+
+/*
+ * bytea_exif_worker_main
+ * Entry point of a background worker. Queue table is processed by batches
+ * while there are entries, then the worker sleeps for naptime. SIGTERM is
+ * handled by die(), hence CHECK_FOR_INTERRUPTS in a long batch query stops
+ * the worker without waiting for end of the batch.
+ */
+void
+bytea_exif_worker_main(Datum main_arg)
+{
+	pqsignal(SIGHUP, exif_worker_sighup);
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+#if PG_VERSION_NUM >= 110000
+	BackgroundWorkerInitializeConnection(exif_worker_database, NULL, 0);
+#else
+	BackgroundWorkerInitializeConnection(exif_worker_database, NULL);
+#endif
+	elog(LOG, "%s started", MyBgworkerEntry->bgw_name);
+
+	for (;;)
+	{
+		int			rc;
+
+		if (got_sighup)
+		{
+			got_sighup = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		while (!got_sighup &&
+			   exif_worker_batch() >= (uint64) exif_worker_batch_size)
+			CHECK_FOR_INTERRUPTS();
+		if (got_sighup)
+			continue;
+
+		rc = WaitLatch(MyLatch,
+					   WL_LATCH_SET | WL_TIMEOUT | WL_POSTMASTER_DEATH,
+					   exif_worker_naptime * 1000L,
+					   PG_WAIT_EXTENSION);
+		ResetLatch(MyLatch);
+		if (rc & WL_POSTMASTER_DEATH)
+			proc_exit(1);
+		CHECK_FOR_INTERRUPTS();
+	}
+}
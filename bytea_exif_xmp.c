@@ -0,0 +1,615 @@
+/*-------------------------------------------------------------------------
+ *
+ * EXIF data extractor for PotgreSQL bytea data
+ * XMP packet extraction without libexif
+ *
+ * (c) 2025, mkgrgis
+ *
+ * IDENTIFICATION
+ *		bytea_exif_xmp.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "bytea_exif.h"
+
+#include "catalog/namespace.h"
+#include "fmgr.h"
+#include "mb/pg_wchar.h"
+#include "nodes/pg_list.h"
+#include "utils/builtins.h"
+#include "utils/jsonb.h"
+#include "utils/xml.h"
+#if PG_VERSION_NUM >= 160000
+	#include "varatt.h"
+#else
+	#include "lib/stringinfo.h"
+#endif
+
+Datum bytea_get_xmp(PG_FUNCTION_ARGS);
+Datum bytea_get_xmp_jsonb(PG_FUNCTION_ARGS);
+
+PG_FUNCTION_INFO_V1(bytea_get_xmp);
+PG_FUNCTION_INFO_V1(bytea_get_xmp_jsonb);
+
+/* APP1 signatures of XMP packet and of extended XMP chunks, with final '\0' */
+#define XMP_STD_SIG			"http://ns.adobe.com/xap/1.0/"
+#define XMP_STD_SIG_LEN		29
+#define XMP_EXT_SIG			"http://ns.adobe.com/xmp/extension/"
+#define XMP_EXT_SIG_LEN		35
+#define XMP_EXT_GUID_LEN	32
+/* signature, GUID, full length and offset of extended XMP chunk */
+#define XMP_EXT_HEADER_LEN	(XMP_EXT_SIG_LEN + XMP_EXT_GUID_LEN + 4 + 4)
+#define XMP_MAX_DEPTH		64
+
+typedef struct XmpProperty
+{
+	char	   *name;
+	List	   *values;
+} XmpProperty;
+
+static uint32
+xmp_get_be32(const unsigned char *p)
+{
+	return ((uint32) p[0] << 24) | ((uint32) p[1] << 16) | ((uint32) p[2] << 8) | (uint32) p[3];
+}
+
+/*
+ * xmp_find_last
+ * Returns last occurrence of a string in a text of len bytes or NULL.
+ */
+static const char *
+xmp_find_last(const char *text, int len, const char *str)
+{
+	int			l = strlen(str);
+
+	for (const char *p = text + len - l; p >= text; p--)
+	{
+		if (memcmp(p, str, l) == 0)
+			return p;
+	}
+	return NULL;
+}
+
+/*
+ * xmp_merge_extended
+ * Extended XMP is a separate x:xmpmeta document. Its rdf:Description
+ * elements are inserted into rdf:RDF element of the main packet, hence the
+ * result is one XML document. Extended XMP without rdf:RDF element or main
+ * packet without end of rdf:RDF element are not merged.
+ */
+static void
+xmp_merge_extended(StringInfo buf, const char *ext, int ext_len)
+{
+	const char *rdf = xmp_find_last(ext, ext_len, "<rdf:RDF");
+	const char *body;
+	const char *body_end = xmp_find_last(ext, ext_len, "</rdf:RDF>");
+	const char *main_end = xmp_find_last(buf->data, buf->len, "</rdf:RDF>");
+	char	   *tail;
+
+	if (rdf == NULL || body_end == NULL || main_end == NULL)
+		return;
+	body = memchr(rdf, '>', body_end - rdf);
+	if (body == NULL)
+		return;
+	body++;
+
+	tail = pstrdup(main_end);
+	buf->len = main_end - buf->data;
+	buf->data[buf->len] = '\0';
+	appendBinaryStringInfo(buf, body, body_end - body);
+	appendStringInfoString(buf, tail);
+	pfree(tail);
+}
+
+/*
+ * xmp_append_char
+ * Appends a character in the database encoding. A character which can not
+ * be converted is appended as numeric character reference, hence there are
+ * no conversion errors for any XMP text.
+ */
+static void
+xmp_append_char(StringInfo buf, pg_wchar c)
+{
+	unsigned char	utf8[8];
+	int				db_encoding = GetDatabaseEncoding();
+	int				len;
+
+	memset(utf8, 0, sizeof(utf8));
+	unicode_to_utf8(c, utf8);
+	len = pg_utf_mblen(utf8);
+	if (c < 0x80 || db_encoding == PG_UTF8 || db_encoding == PG_SQL_ASCII)
+	{
+		appendBinaryStringInfo(buf, (char *) utf8, len);
+		return;
+	}
+#if PG_VERSION_NUM >= 140000
+	{
+		static Oid		proc = InvalidOid;
+		unsigned char	res[4 * MAX_CONVERSION_GROWTH + 1];
+
+		if (!OidIsValid(proc))
+			proc = FindDefaultConversionProc(PG_UTF8, db_encoding);
+		if (OidIsValid(proc) &&
+			pg_do_encoding_conversion_buf(proc, PG_UTF8, db_encoding,
+										  utf8, len, res, sizeof(res), true) == len)
+		{
+			appendStringInfoString(buf, (char *) res);
+			return;
+		}
+	}
+#endif
+	appendStringInfo(buf, "&#x%X;", (unsigned int) c);
+}
+
+/*
+ * exif_xmp_extract
+ * Locates XMP APP1 segment and extended XMP chunks by JPEG marker scan.
+ * Returns XMP packet in the database encoding with merged extended XMP
+ * if there is such data or NULL if there is no XMP data.
+ */
+static char *
+exif_xmp_extract(Datum d)
+{
+	ExifByteaReader		r;
+	ExifJpegSegment		seg;
+	int					i = 0;
+	char			   *main_xmp = NULL;
+	int					main_len = 0;
+	char			   *ext_xmp = NULL;
+	uint32				ext_len = 0;
+	char				ext_guid[XMP_EXT_GUID_LEN];
+	StringInfoData		buf;
+	StringInfoData		res;
+	int					db_encoding;
+
+	exif_reader_init(&r, d);
+	if (!exif_is_jpeg(&r))
+	{
+		exif_reader_free(&r);
+		return NULL;
+	}
+
+	while (exif_jpeg_next_segment(&r, &i, &seg))
+	{
+		const unsigned char *p;
+
+		if (seg.marker != JPEG_MARKER_APP1)
+			continue;
+
+		if (main_xmp == NULL && seg.length > XMP_STD_SIG_LEN)
+		{
+			p = exif_reader_fetch(&r, seg.offset, XMP_STD_SIG_LEN);
+			if (p != NULL && memcmp(p, XMP_STD_SIG, XMP_STD_SIG_LEN) == 0)
+			{
+				main_len = seg.length - XMP_STD_SIG_LEN;
+				p = exif_reader_fetch(&r, seg.offset + XMP_STD_SIG_LEN, main_len);
+				if (p == NULL)
+					break;
+				main_xmp = palloc(main_len);
+				memcpy(main_xmp, p, main_len);
+				continue;
+			}
+		}
+
+		if (seg.length > XMP_EXT_HEADER_LEN)
+		{
+			uint32	full_len;
+			uint32	chunk_off;
+			int32	chunk_len = seg.length - XMP_EXT_HEADER_LEN;
+
+			p = exif_reader_fetch(&r, seg.offset, XMP_EXT_HEADER_LEN);
+			if (p == NULL || memcmp(p, XMP_EXT_SIG, XMP_EXT_SIG_LEN) != 0)
+				continue;
+
+			full_len = xmp_get_be32(p + XMP_EXT_SIG_LEN + XMP_EXT_GUID_LEN);
+			chunk_off = xmp_get_be32(p + XMP_EXT_SIG_LEN + XMP_EXT_GUID_LEN + 4);
+			if (ext_xmp == NULL)
+			{
+				/* extended XMP can't be longer than all of data */
+				if (full_len == 0 || full_len > r.size)
+					continue;
+				memcpy(ext_guid, p + XMP_EXT_SIG_LEN, XMP_EXT_GUID_LEN);
+				ext_len = full_len;
+				ext_xmp = palloc0(ext_len);
+			}
+			else if (memcmp(ext_guid, p + XMP_EXT_SIG_LEN, XMP_EXT_GUID_LEN) != 0)
+				continue; /* other extended XMP document */
+
+			if ((uint64) chunk_off + chunk_len > ext_len)
+				continue;
+			p = exif_reader_fetch(&r, seg.offset + XMP_EXT_HEADER_LEN, chunk_len);
+			if (p == NULL)
+				break;
+			memcpy(ext_xmp + chunk_off, p, chunk_len);
+		}
+	}
+	exif_reader_free(&r);
+
+	if (main_xmp == NULL)
+		return NULL;
+
+	/* XMP is always UTF-8, some writers add final '\0' to the packet */
+	initStringInfo(&buf);
+	appendBinaryStringInfo(&buf, main_xmp, strnlen(main_xmp, main_len));
+	if (ext_xmp != NULL)
+		xmp_merge_extended(&buf, ext_xmp, strnlen(ext_xmp, ext_len));
+	pfree(main_xmp);
+	if (ext_xmp != NULL)
+		pfree(ext_xmp);
+
+	if (!pg_verify_mbstr(PG_UTF8, buf.data, buf.len, true))
+	{
+		exif_report_xmp(false, r.size);
+		pfree(buf.data);
+		return NULL;
+	}
+	db_encoding = GetDatabaseEncoding();
+	if (db_encoding == PG_UTF8 || db_encoding == PG_SQL_ASCII)
+		return buf.data;
+
+	initStringInfo(&res);
+	for (const char *c = buf.data; *c; c += pg_utf_mblen((const unsigned char *) c))
+	{
+		if (IS_HIGHBIT_SET(*c))
+			xmp_append_char(&res, utf8_to_unicode((const unsigned char *) c));
+		else
+			appendStringInfoChar(&res, *c);
+	}
+	pfree(buf.data);
+	return res.data;
+}
+
+/*
+ * bytea_get_xmp
+ * Returns XMP packet as xml or NULL with a warning if the packet is not
+ * well-formed, the check doesn't raise errors of XML parser.
+ */
+Datum
+bytea_get_xmp(PG_FUNCTION_ARGS)
+{
+	char	   *xmp = exif_xmp_extract(PG_GETARG_DATUM(0));
+	text	   *t;
+
+	if (xmp == NULL)
+		PG_RETURN_NULL();
+
+	t = cstring_to_text(xmp);
+	if (!DatumGetBool(DirectFunctionCall1(xml_is_well_formed_content, PointerGetDatum(t))))
+	{
+		exif_report_xmp(true, exif_datum_size(PG_GETARG_DATUM(0)));
+		PG_RETURN_NULL();
+	}
+	PG_RETURN_XML_P(xmlparse(t, XMLOPTION_CONTENT, true));
+}
+
+/*
+ * xmp_decode
+ * Returns a copy of XML text with decoded predefined and numeric entities.
+ * Content of CDATA sections is copied as is. Numeric entities of characters
+ * not allowed in XML are not decoded.
+ */
+static char *
+xmp_decode(const char *s, int len)
+{
+	StringInfoData	buf;
+	const char	   *end = s + len;
+
+	initStringInfo(&buf);
+	while (s < end)
+	{
+		const char *semi;
+
+		if (end - s >= 9 && strncmp(s, "<![CDATA[", 9) == 0)
+		{
+			const char *cdata = s + 9;
+			const char *cdata_end = cdata;
+
+			while (cdata_end + 3 <= end && strncmp(cdata_end, "]]>", 3) != 0)
+				cdata_end++;
+			if (cdata_end + 3 > end)
+				cdata_end = end;
+			appendBinaryStringInfo(&buf, cdata, cdata_end - cdata);
+			s = Min(cdata_end + 3, end);
+			continue;
+		}
+
+		if (*s != '&' || (semi = memchr(s, ';', end - s)) == NULL)
+		{
+			appendStringInfoChar(&buf, *s++);
+			continue;
+		}
+
+		if (strncmp(s, "&lt;", 4) == 0)
+			appendStringInfoChar(&buf, '<');
+		else if (strncmp(s, "&gt;", 4) == 0)
+			appendStringInfoChar(&buf, '>');
+		else if (strncmp(s, "&amp;", 5) == 0)
+			appendStringInfoChar(&buf, '&');
+		else if (strncmp(s, "&quot;", 6) == 0)
+			appendStringInfoChar(&buf, '"');
+		else if (strncmp(s, "&apos;", 6) == 0)
+			appendStringInfoChar(&buf, '\'');
+		else if (s[1] == '#')
+		{
+			unsigned long	c = (s[2] == 'x' || s[2] == 'X') ?
+								strtoul(s + 3, NULL, 16) :
+								strtoul(s + 2, NULL, 10);
+
+			/* not allowed in XML: control characters and surrogates */
+			if ((c < 0x20 && c != '\t' && c != '\n' && c != '\r') ||
+				(c >= 0xD800 && c <= 0xDFFF) || c > 0x10FFFF)
+			{
+				appendStringInfoChar(&buf, *s++);
+				continue;
+			}
+			xmp_append_char(&buf, (pg_wchar) c);
+		}
+		else
+		{
+			appendStringInfoChar(&buf, *s++);
+			continue;
+		}
+		s = semi + 1;
+	}
+	return buf.data;
+}
+
+static void
+xmp_add_property(List **props, const char *name, int name_len, char *value)
+{
+	ListCell	   *lc;
+	XmpProperty	   *prop;
+
+	foreach(lc, *props)
+	{
+		prop = (XmpProperty *) lfirst(lc);
+		if (strncmp(prop->name, name, name_len) == 0 && prop->name[name_len] == '\0')
+		{
+			prop->values = lappend(prop->values, value);
+			return;
+		}
+	}
+	prop = palloc(sizeof(XmpProperty));
+	prop->name = pnstrdup(name, name_len);
+	prop->values = list_make1(value);
+	*props = lappend(*props, prop);
+}
+
+static bool
+xmp_has_prefix(const char *name, int name_len, const char *prefix)
+{
+	int		prefix_len = strlen(prefix);
+
+	return name_len >= prefix_len && strncmp(name, prefix, prefix_len) == 0;
+}
+
+/*
+ * xmp_attribute_is_property
+ * Namespace declarations and RDF syntax attributes are not XMP properties.
+ */
+static bool
+xmp_attribute_is_property(const char *name, int name_len)
+{
+	return !(xmp_has_prefix(name, name_len, "xmlns") ||
+			 xmp_has_prefix(name, name_len, "xml:") ||
+			 xmp_has_prefix(name, name_len, "rdf:") ||
+			 xmp_has_prefix(name, name_len, "x:"));
+}
+
+static bool
+xmp_is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/*
+ * xmp_flatten
+ * Simple parser of serialized RDF/XML of XMP packet. Returns list of
+ * properties, both from attributes and from simple element values.
+ * A value of an array item (rdf:li) belongs to the nearest not RDF
+ * element, for example dc:subject.
+ */
+static List *
+xmp_flatten(const char *s)
+{
+	const char	   *names[XMP_MAX_DEPTH];
+	int				name_lens[XMP_MAX_DEPTH];
+	bool			has_child[XMP_MAX_DEPTH];
+	int				depth = 0;
+	const char	   *text = s;
+	List		   *props = NIL;
+
+	while (*s)
+	{
+		const char *q;
+
+		if (*s != '<')
+		{
+			s++;
+			continue;
+		}
+
+		if (strncmp(s, "<![CDATA[", 9) == 0)
+		{
+			/* CDATA section is a part of the text, see xmp_decode */
+			q = strstr(s, "]]>");
+			if (q == NULL)
+				break;
+			s = q + 3;
+			continue;
+		}
+
+		if (strncmp(s, "<?", 2) == 0 || strncmp(s, "<!--", 4) == 0 || (s[1] == '!'))
+		{
+			/* processing instruction, comment or declaration */
+			const char *term = s[1] == '?' ? "?>" : (s[2] == '-' ? "-->" : ">");
+
+			q = strstr(s, term);
+			if (q == NULL)
+				break;
+			s = q + strlen(term);
+			text = s;
+			continue;
+		}
+
+		if (s[1] == '/')
+		{
+			/* end tag */
+			q = strchr(s, '>');
+			if (q == NULL)
+				break;
+			if (depth > 0)
+			{
+				depth--;
+				if (depth < XMP_MAX_DEPTH && !has_child[depth])
+				{
+					const char *b = text;
+					const char *e = s;
+
+					while (b < e && xmp_is_space(*b))
+						b++;
+					while (e > b && xmp_is_space(e[-1]))
+						e--;
+					if (e > b)
+					{
+						int		k = depth;
+
+						while (k > 0 && xmp_has_prefix(names[k], name_lens[k], "rdf:"))
+							k--;
+						xmp_add_property(&props, names[k], name_lens[k], xmp_decode(b, e - b));
+					}
+				}
+			}
+			s = q + 1;
+			text = s;
+			continue;
+		}
+
+		/* start tag */
+		{
+			const char *name = ++s;
+			int			name_len;
+			bool		empty = false;
+
+			while (*s && !xmp_is_space(*s) && *s != '/' && *s != '>')
+				s++;
+			name_len = s - name;
+
+			for (;;)
+			{
+				const char *aname;
+				int			aname_len;
+				char		quote;
+				const char *value;
+
+				while (xmp_is_space(*s))
+					s++;
+				if (*s == '\0')
+					break;
+				if (*s == '/')
+				{
+					empty = true;
+					s++;
+					continue;
+				}
+				if (*s == '>')
+				{
+					s++;
+					break;
+				}
+
+				aname = s;
+				while (*s && *s != '=' && !xmp_is_space(*s) && *s != '>')
+					s++;
+				aname_len = s - aname;
+				while (xmp_is_space(*s))
+					s++;
+				if (*s != '=')
+					continue;
+				s++;
+				while (xmp_is_space(*s))
+					s++;
+				quote = *s;
+				if (quote != '"' && quote != '\'')
+					continue;
+				value = ++s;
+				q = strchr(s, quote);
+				if (q == NULL)
+				{
+					s += strlen(s);
+					break;
+				}
+				s = q + 1;
+				if (xmp_attribute_is_property(aname, aname_len))
+					xmp_add_property(&props, aname, aname_len, xmp_decode(value, q - value));
+			}
+
+			if (depth > 0 && depth <= XMP_MAX_DEPTH)
+				has_child[depth - 1] = true;
+			if (!empty)
+			{
+				if (depth < XMP_MAX_DEPTH)
+				{
+					names[depth] = name;
+					name_lens[depth] = name_len;
+					has_child[depth] = false;
+				}
+				depth++;
+			}
+			text = s;
+		}
+	}
+	return props;
+}
+
+static void
+xmp_push_string(JsonbParseState **pstate, JsonbIteratorToken seq, char *str)
+{
+	JsonbValue	v;
+
+	v.type = jbvString;
+	v.val.string.val = str;
+	v.val.string.len = strlen(str);
+	pushJsonbValue(pstate, seq, &v);
+}
+
+/*
+ * bytea_get_xmp_jsonb
+ * Returns flattened XMP properties as jsonb {"prefix:Name" : value}.
+ * Repeated properties, for example items of rdf:Seq, are JSON arrays.
+ * jsonb is built from the values without parsing of JSON text.
+ */
+Datum
+bytea_get_xmp_jsonb(PG_FUNCTION_ARGS)
+{
+	char		   *xmp = exif_xmp_extract(PG_GETARG_DATUM(0));
+	List		   *props;
+	ListCell	   *lc;
+	JsonbParseState *pstate = NULL;
+	JsonbValue	   *res;
+
+	if (xmp == NULL)
+		PG_RETURN_NULL();
+
+	props = xmp_flatten(xmp);
+	pushJsonbValue(&pstate, WJB_BEGIN_OBJECT, NULL);
+	foreach(lc, props)
+	{
+		XmpProperty	   *prop = (XmpProperty *) lfirst(lc);
+		bool			is_array = list_length(prop->values) > 1;
+		ListCell	   *lcv;
+
+		xmp_push_string(&pstate, WJB_KEY, prop->name);
+		if (is_array)
+			pushJsonbValue(&pstate, WJB_BEGIN_ARRAY, NULL);
+		foreach(lcv, prop->values)
+			xmp_push_string(&pstate, is_array ? WJB_ELEM : WJB_VALUE, (char *) lfirst(lcv));
+		if (is_array)
+			pushJsonbValue(&pstate, WJB_END_ARRAY, NULL);
+	}
+	res = pushJsonbValue(&pstate, WJB_END_OBJECT, NULL);
+
+	PG_RETURN_POINTER(JsonbValueToJsonb(res));
+}
@@ -0,0 +1 @@
+../17.0/bytea_exif_extract.sql
\ No newline at end of file
@@ -0,0 +1 @@
+../17.0/bytea_exif_worker.sql
\ No newline at end of file
@@ -101,5 +101,237 @@ SELECT id,
 		bytea_get_exif_user_comment(img) IS NULL n
 FROM img;
 
+--Testcase 032:
+SELECT exif_tag_histogram(img, ARRAY['Make', 'Model', 'GPSMapDatum']) h FROM img;
+
+--Testcase 033:
+SELECT id,
+       bytea_get_xmp_jsonb(img) ->> 'xmp:CreatorTool' tool,
+       bytea_get_xmp_jsonb(img) ->> 'dc:creator' creator,
+       bytea_get_xmp_jsonb(img) -> 'stEvt:action' actions,
+       bytea_get_xmp_jsonb(img) IS NULL n
+FROM img;
+
+--Testcase 034:
+WITH t AS (
+  SELECT substring(img from 13 for 8684) tiff,
+         substring(img from 7 for 8690) app1
+  FROM img WHERE id = 1
+), c AS (
+  SELECT 'png' f, '\x89504e470d0a1a0a000021ec65584966'::bytea || tiff || '\x000000000000000049454e44ae426082'::bytea d FROM t
+  UNION ALL
+  SELECT 'webp', '\x52494646f82100005745425045584946ec210000'::bytea || tiff FROM t
+  UNION ALL
+  SELECT 'heif', '\x000000186674797068656963000000006d696631686569630000004d6d657461000000000000002369696e6600000000000100000015696e6665020000000001000045786966000000001e696c6f6300000000440000010001000000010000006d000021f6000021fe6d64617400000006'::bytea || app1 FROM t
+)
+SELECT f,
+       bytea_has_exif(d) exif,
+       bytea_get_exif_tag_value(d, 'Model') model,
+       bytea_get_exif_point(d) point
+FROM c
+ORDER BY f;
+
+--Testcase 035:
+SELECT id,
+       to_char(bytea_get_exif_datetime_original(img), 'YYYY-MM-DD HH24:MI:SS.US TZ') ts,
+       bytea_get_exif_datetime_digitized(img) = bytea_get_exif_datetime_original(img) d
+FROM img;
+--Testcase 036:
+CREATE TABLE photo (
+  id int PRIMARY KEY,
+  img bytea,
+  make text,
+  model varchar(32),
+  iso int,
+  fnumber numeric(4,1),
+  taken timestamptz,
+  taken_local timestamp
+);
+--Testcase 037:
+CREATE TRIGGER photo_exif BEFORE INSERT OR UPDATE ON photo
+FOR EACH ROW EXECUTE PROCEDURE bytea_exif_fill_columns('img', 'Make=make', 'Model=model', 'ISOSpeedRatings=iso', 'FNumber=fnumber', 'DateTimeOriginal=taken', 'DateTimeOriginal=taken_local');
+--Testcase 038:
+INSERT INTO photo (id, img) SELECT id, img FROM img;
+--Testcase 039:
+UPDATE photo SET make = 'unchanged image' WHERE id = 1;
 --Testcase 040:
+UPDATE photo SET img = NULL WHERE id = 2;
+--Testcase 041:
+SELECT id, make, model, iso, fnumber,
+       to_char(taken, 'YYYY-MM-DD HH24:MI:SS.US') taken,
+       to_char(taken_local, 'YYYY-MM-DD HH24:MI:SS') taken_local
+FROM photo
+ORDER BY id;
+--Testcase 042:
+DROP TABLE photo;
+--Testcase 043:
+SELECT id, (s).has_exif exif, (s).make, (s).model,
+       (s).lens_model IS NOT DISTINCT FROM bytea_get_exif_tag_value(img, 'LensModel') lens,
+       to_char((s).datetime_original, 'YYYY-MM-DD HH24:MI:SS.US') dto,
+       to_char((s).gps_utc_timestamp, 'YYYY-MM-DD HH24:MI:SS') gps,
+       (s).point, (s).dest_point IS NOT NULL dest,
+       (s).user_comment IS NOT DISTINCT FROM bytea_get_exif_user_comment(img) uc
+FROM (SELECT id, img, bytea_exif_summary(img) s FROM img) t
+ORDER BY id;
+--Testcase 044:
+SELECT id, bytea_exif_fingerprint(img) fp, bytea_exif_fingerprint(img) IS NULL n FROM img;
+--Testcase 045:
+WITH t AS (
+  SELECT img, substring(img from 13 for 8684) tiff FROM img WHERE id = 1
+)
+SELECT bytea_exif_fingerprint(substring(img from 1 for 8696) || '\xffd9'::bytea) = bytea_exif_fingerprint(img) cut,
+       bytea_exif_fingerprint('\x89504e470d0a1a0a000021ec65584966'::bytea || tiff || '\x000000000000000049454e44ae426082'::bytea) = bytea_exif_fingerprint(img) png,
+       bytea_exif_fingerprint('\x52494646f82100005745425045584946ec210000'::bytea || tiff) = bytea_exif_fingerprint(img) webp,
+       bytea_exif_fingerprint('\x457869660000'::bytea || tiff) = bytea_exif_fingerprint(img) raw
+FROM t;
+--Testcase 046:
+SELECT id, bytea_get_exif_makernote_jsonb(img) mn, bytea_get_exif_makernote_jsonb(img) IS NULL n FROM img;
+--Testcase 047:
+SELECT ord, has_exif exif, make, model,
+       to_char(datetime_original, 'YYYY-MM-DD HH24:MI:SS.US') dto,
+       to_char(gps_utc_timestamp, 'YYYY-MM-DD HH24:MI:SS') gps,
+       point IS NOT NULL pt
+FROM bytea_exif_summary_batch((SELECT array_agg(img ORDER BY id) FROM img));
+--Testcase 048:
+SELECT count(*) FROM (
+  SELECT * FROM bytea_exif_summary_batch((SELECT array_agg(img ORDER BY id) FROM img))
+  EXCEPT
+  SELECT id + 1, (bytea_exif_summary(img)).* FROM img
+) t;
+set bytea_exif.batch_threads to 1;
+--Testcase 049:
+SELECT count(*) FROM (
+  SELECT * FROM bytea_exif_summary_batch((SELECT array_agg(img ORDER BY id) FROM img))
+  EXCEPT
+  SELECT id + 1, (bytea_exif_summary(img)).* FROM img
+) t;
+reset bytea_exif.batch_threads;
+--Testcase 050:
+SELECT count(*) FROM bytea_exif_summary_batch('{}'::bytea[]);
+--Testcase 051:
+CREATE TABLE bad AS SELECT n, overlay(overlay(img placing '13'::bytea from 640 for 2) placing 'xx'::bytea from 666 for 2) img FROM img, generate_series(1, 3) n WHERE id = 1;
+--Testcase 052:
+SELECT id, count(d.problem) n FROM img LEFT JOIN LATERAL bytea_exif_diagnose(img) d ON true GROUP BY id ORDER BY id;
+--Testcase 053:
+SELECT * FROM bytea_exif_diagnose((SELECT img FROM bad WHERE n = 1));
+--Testcase 054:
+SELECT n, bytea_get_exif_datetime_digitized(img) dtd FROM bad WHERE n = 1;
+set bytea_exif.diagnostics to summary;
+--Testcase 055:
+SELECT count(bytea_get_exif_datetime_original(img)) o, count(bytea_get_exif_datetime_digitized(img)) d FROM bad;
+set bytea_exif.diagnostics to off;
+--Testcase 056:
+SELECT count(bytea_get_exif_datetime_original(img)) o, count(bytea_get_exif_datetime_digitized(img)) d FROM bad;
+reset bytea_exif.diagnostics;
+--Testcase 057:
+DROP TABLE bad;
+--Testcase 058:
+CREATE TABLE mn AS SELECT x a, overlay(x placing '\x7d'::bytea from 105 for 1) b FROM (VALUES ('\xffd8ffe1010145786966000049492a000800000003000f010200060000003200000010010200150000003800000069870400010000004e0000000000000043616e6f6e0043616e6f6e20506f77657253686f7420546573740000020003900200140000006c0000007c920700790000008000000000000000323032343a30353a30362030373a30383a30390003000600020018000000aa0000000700020017000000c20000000900020020000000d900000000000000494d473a506f77657253686f742054657374204a504547004669726d776172652056657273696f6e20312e302e300062797465615f6578696620746573740000000000000000000000000000000000ffd9'::bytea)) v(x);
+--Testcase 059:
+SELECT bytea_get_exif_makernote_jsonb(a) mn, bytea_get_exif_makernote_jsonb(b) IS NULL b FROM mn;
+--Testcase 060:
+SELECT bytea_get_exif_json(a)::jsonb ? 'MakerNote' a_mn, bytea_get_exif_json(b)::jsonb ? 'MakerNote' b_mn,
+       bytea_get_exif_json(a)::jsonb - 'MakerNote' = bytea_get_exif_json(b)::jsonb same,
+       bytea_get_exif_json(a)::jsonb ->> 'DateTimeOriginal' dto
+FROM mn;
+--Testcase 061:
+SELECT s.has_exif exif, s.make, s.model, to_char(s.datetime_original, 'YYYY-MM-DD HH24:MI:SS') dto,
+       bytea_exif_summary(a)::text = bytea_exif_summary(b)::text same
+FROM mn, bytea_exif_summary(a) s;
+--Testcase 082:
+SELECT m.n - d.n pos
+FROM mn,
+     LATERAL (SELECT n FROM json_object_keys(bytea_get_exif_json(a)) WITH ORDINALITY k(k, n) WHERE k = 'MakerNote') m,
+     LATERAL (SELECT n FROM json_object_keys(bytea_get_exif_json(a)) WITH ORDINALITY k(k, n) WHERE k = 'DateTimeOriginal') d;
+--Testcase 062:
+DROP TABLE mn;
+--Testcase 063:
+CREATE TABLE photo_bad (id int, img bytea, make varchar(5), iso numeric(2,0), flag bool);
+--Testcase 064:
+CREATE TRIGGER photo_bad_exif BEFORE INSERT ON photo_bad
+FOR EACH ROW EXECUTE PROCEDURE bytea_exif_fill_columns('img', 'Make=make', 'ISOSpeedRatings=iso', 'Make=flag');
+--Testcase 065:
+INSERT INTO photo_bad (id, img) SELECT id, img FROM img;
+--Testcase 066:
+SELECT id, make, iso, flag FROM photo_bad ORDER BY id;
+--Testcase 067:
+DROP TABLE photo_bad;
+--Testcase 068:
+SELECT ord, has_exif exif FROM bytea_exif_summary_batch('[0:1]={NULL,"\\x00"}'::bytea[]);
+--Testcase 069:
+SELECT exif_tag_histogram(img, ARRAY['Make', 'Model']) h
+FROM (SELECT overlay(overlay(img placing '\x01'::bytea from 140 for 1) placing '\xff'::bytea from 153 for 1) img FROM img WHERE id = 1
+      UNION ALL
+      SELECT img FROM img WHERE id = 4) t;
+--Testcase 070:
+SELECT exif_tag_histogram(img, CASE WHEN id < 4 THEN ARRAY['Make'] ELSE ARRAY['Model'] END ORDER BY id) h FROM img;
+--Testcase 083:
+SELECT exif_tag_histogram(img, ARRAY['Make', 'Model', 'Make']) h FROM img;
+--Testcase 071:
+CREATE TABLE xmp AS SELECT x a, overlay(x placing '9'::bytea from 382 for 1) b FROM (VALUES ('\xffd8ffe10231687474703a2f2f6e732e61646f62652e636f6d2f7861702f312e302f003c3f787061636b657420626567696e3d22222069643d2257354d304d7043656869487a7265537a4e54637a6b633964223f3e3c783a786d706d65746120786d6c6e733a783d2261646f62653a6e733a6d6574612f223e3c7264663a52444620786d6c6e733a7264663d22687474703a2f2f7777772e77332e6f72672f313939392f30322f32322d7264662d73796e7461782d6e7323223e3c7264663a4465736372697074696f6e207264663a61626f75743d222220786d6c6e733a64633d22687474703a2f2f7075726c2e6f72672f64632f656c656d656e74732f312e312f2220786d6c6e733a786d703d22687474703a2f2f6e732e61646f62652e636f6d2f7861702f312e302f2220786d6c6e733a786d704e6f74653d22687474703a2f2f6e732e61646f62652e636f6d2f786d702f6e6f74652f2220786d703a43726561746f72546f6f6c3d22412026616d703b204226237834313b2623313b2220786d704e6f74653a486173457874656e646564584d503d223031323334353637383941424344454630313233343536373839414243444546223e3c64633a6465736372697074696f6e3e3c215b43444154415b3c623e626f6c643c2f623e2026206d6f72655d5d3e3c2f64633a6465736372697074696f6e3e3c2f7264663a4465736372697074696f6e3e3c2f7264663a5244463e3c2f783a786d706d6574613e3c3f787061636b657420656e643d2277223f3effe100c3687474703a2f2f6e732e61646f62652e636f6d2f786d702f657874656e73696f6e2f003031323334353637383941424344454630313233343536373839414243444546000000ec000000767264663a61626f75743d222220786d6c6e733a70686f746f73686f703d22687474703a2f2f6e732e61646f62652e636f6d2f70686f746f73686f702f312e302f222070686f746f73686f703a486973746f72793d22657874656e646564222f3e3c2f7264663a5244463e3c2f783a786d706d6574613effe100c3687474703a2f2f6e732e61646f62652e636f6d2f786d702f657874656e73696f6e2f003031323334353637383941424344454630313233343536373839414243444546000000ec000000003c783a786d706d65746120786d6c6e733a783d2261646f62653a6e733a6d6574612f223e3c7264663a52444620786d6c6e733a7264663d22687474703a2f2f7777772e77332e6f72672f313939392f30322f32322d7264662d73796e7461782d6e7323223e3c7264663a4465736372697074696f6e20ffd9'::bytea)) v(x);
+--Testcase 072:
+SELECT bytea_get_xmp_jsonb(a) a, bytea_get_xmp_jsonb(b) ->> 'xmp:CreatorTool' = E'A & BA\t' b FROM xmp;
+--Testcase 073:
+SELECT bytea_get_xmp(b) IS DOCUMENT doc,
+       xpath('count(//rdf:Description)', bytea_get_xmp(b), ARRAY[ARRAY['rdf', 'http://www.w3.org/1999/02/22-rdf-syntax-ns#']]) n,
+       xpath('//@photoshop:History', bytea_get_xmp(b), ARRAY[ARRAY['photoshop', 'http://ns.adobe.com/photoshop/1.0/']]) h
+FROM xmp;
+--Testcase 081:
+SELECT bytea_get_xmp(overlay(a placing 'x'::bytea from 86 for 1)) IS NULL xml,
+       bytea_get_xmp_jsonb(overlay(a placing '\xff'::bytea from 86 for 1)) IS NULL utf8
+FROM xmp;
+--Testcase 074:
+DROP TABLE xmp;
+--Testcase 075:
+CREATE TABLE dmg AS SELECT id, img, '\xffd8ab'::bytea || '\xff00ffd3ffe2ffff'::bytea || substring(img from 3) d FROM img WHERE id IN (1, 2, 4, 5, 8);
+--Testcase 076:
+SELECT id, bytea_get_exif_json(d)::text = bytea_get_exif_json(img)::text exif,
+       bytea_get_xmp_jsonb(d) IS NOT DISTINCT FROM bytea_get_xmp_jsonb(img) xmp,
+       bytea_exif_fingerprint(d) = bytea_exif_fingerprint(img) fp
+FROM dmg
+ORDER BY id;
+--Testcase 077:
+DROP TABLE dmg;
+set bytea_exif.diagnostics to summary;
+--Testcase 078:
+DO $$
+DECLARE
+  b bytea := (SELECT overlay(img placing '13'::bytea from 640 for 2) FROM img WHERE id = 1);
+  t timestamptz;
+BEGIN
+  BEGIN
+    t := bytea_get_exif_datetime_original(b);
+    RAISE EXCEPTION 'rollback';
+  EXCEPTION WHEN raise_exception THEN
+    NULL;
+  END;
+  t := bytea_get_exif_datetime_original(b);
+END $$;
+reset bytea_exif.diagnostics;
+--Testcase 079:
+SELECT id, bytea_get_exif_jsonb(img) = bytea_get_exif_json(img)::jsonb same FROM img ORDER BY id;
+--Testcase 080:
+SELECT bytea_get_exif_jsonb(b) -> 'Make' make, bytea_get_exif_jsonb(b) ? 'Model' model
+FROM (SELECT overlay(overlay(img placing '\x01'::bytea from 140 for 1) placing '\xff'::bytea from 153 for 1) b FROM img WHERE id = 1) t;
+--Testcase 084:
+CREATE TABLE tz AS SELECT x a, overlay(x placing ':'::bytea from 92 for 1) b FROM (VALUES ('\xffd8ffe1005b45786966000049492a0008000000010069870400010000001a00000000000000020003900200140000003800000011900200070000004c00000000000000323032343a30353a30362030373a30383a3039002b30332d303000ffd9'::bytea)) v(x);
+--Testcase 085:
+SELECT to_char(bytea_get_exif_datetime_original(a) AT TIME ZONE 'UTC', 'YYYY-MM-DD HH24:MI:SS') a,
+       to_char(bytea_get_exif_datetime_original(b) AT TIME ZONE 'UTC', 'YYYY-MM-DD HH24:MI:SS') b
+FROM tz;
+--Testcase 086:
+SELECT * FROM bytea_exif_diagnose((SELECT a FROM tz));
+--Testcase 087:
+DROP TABLE tz;
+--Testcase 200:
+DROP EXTENSION bytea_exif CASCADE;
+--Testcase 201:
+CREATE EXTENSION bytea_exif VERSION '1.0';
+--Testcase 202:
+SELECT extversion, to_regproc('bytea_exif_summary') IS NULL s FROM pg_extension WHERE extname = 'bytea_exif';
+--Testcase 203:
+ALTER EXTENSION bytea_exif UPDATE;
+--Testcase 204:
+SELECT extversion, to_regproc('bytea_exif_summary') IS NULL s FROM pg_extension WHERE extname = 'bytea_exif';
+--Testcase 205:
 DROP EXTENSION bytea_exif CASCADE;
@@ -0,0 +1,76 @@
+--Testcase 001:
+CREATE EXTENSION bytea_exif;
+--Testcase 002:
+CREATE TABLE img (id int2 not null, img bytea);
+--Testcase 003:
+\copy img from './sql/test_images.data';
+--Testcase 004:
+set timezone to 'UTC';
+--Testcase 005:
+\! rm -rf results/extract && mkdir -p results/extract/sub
+--Testcase 006:
+\copy (SELECT encode(img, 'hex') FROM img WHERE id = 1) TO PROGRAM 'xxd -r -p > results/extract/1'
+--Testcase 007:
+\copy (SELECT encode(img, 'hex') FROM img WHERE id = 2) TO PROGRAM 'xxd -r -p > results/extract/2'
+--Testcase 008:
+\copy (SELECT encode(img, 'hex') FROM img WHERE id = 3) TO PROGRAM 'xxd -r -p > results/extract/3'
+--Testcase 009:
+\copy (SELECT encode(img, 'hex') FROM img WHERE id = 4) TO PROGRAM 'xxd -r -p > results/extract/sub/4'
+--Testcase 010:
+\copy (SELECT encode(img, 'hex') FROM img WHERE id = 5) TO PROGRAM 'xxd -r -p > results/extract/sub/5'
+--Testcase 011:
+\copy (SELECT encode(img, 'hex') FROM img WHERE id = 6) TO PROGRAM 'xxd -r -p > results/extract/sub/6'
+--Testcase 012:
+\copy (SELECT encode(img, 'hex') FROM img WHERE id = 7) TO PROGRAM 'xxd -r -p > results/extract/sub/7'
+--Testcase 013:
+\copy (SELECT encode(img, 'hex') FROM img WHERE id = 8) TO PROGRAM 'xxd -r -p > results/extract/8'
+--Testcase 014:
+\! ln -s .. results/extract/sub/up
+
+--Testcase 020:
+CREATE TABLE extract_text (path text, has_exif bool, make text, model text, lens_model text, datetime_original timestamptz, gps_utc_timestamp timestamptz, point text, dest_point text, user_comment text);
+--Testcase 021:
+CREATE TABLE extract_bin (LIKE extract_text);
+--Testcase 022:
+\copy extract_text FROM PROGRAM './bytea_exif_extract -j 4 results/extract'
+--Testcase 023:
+\copy extract_bin FROM PROGRAM './bytea_exif_extract -j 4 -b results/extract' WITH (FORMAT binary)
+--Testcase 024:
+SELECT path, has_exif exif, make, model,
+       to_char(datetime_original, 'YYYY-MM-DD HH24:MI:SS.US') dto,
+       to_char(gps_utc_timestamp, 'YYYY-MM-DD HH24:MI:SS') gps,
+       point IS NOT NULL pt, user_comment IS NOT NULL uc
+FROM extract_text ORDER BY path;
+--Testcase 025:
+SELECT count(*) FROM (
+  (SELECT * FROM extract_text EXCEPT SELECT * FROM extract_bin)
+  UNION ALL
+  (SELECT * FROM extract_bin EXCEPT SELECT * FROM extract_text)
+) t;
+--Testcase 026:
+SELECT count(*) FROM (
+  SELECT substring(path from '[0-9]+$')::int2, has_exif, make, model, lens_model, datetime_original, gps_utc_timestamp, point, dest_point, user_comment FROM extract_text
+  EXCEPT
+  SELECT id, (bytea_exif_summary(img)).* FROM img
+) t;
+--Testcase 027:
+\copy extract_bin FROM PROGRAM './bytea_exif_extract -j 1 -b results/extract/1 results/extract/sub' WITH (FORMAT binary)
+--Testcase 028:
+SELECT count(*), count(DISTINCT path) FROM extract_bin;
+
+--Testcase 040:
+TRUNCATE extract_bin;
+--Testcase 041:
+\copy extract_bin FROM PROGRAM './bytea_exif_extract -j 2 -L -b results/extract/sub results/extract' WITH (FORMAT binary)
+--Testcase 042:
+SELECT count(*), count(DISTINCT substring(path from '[0-9]+$')) FROM extract_bin;
+
+--Testcase 030:
+DROP TABLE extract_text;
+--Testcase 031:
+DROP TABLE extract_bin;
+--Testcase 032:
+DROP TABLE img;
+--Testcase 033:
+DROP EXTENSION bytea_exif CASCADE;
+\! rm -rf results/extract
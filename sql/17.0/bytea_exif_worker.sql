@@ -0,0 +1,74 @@
+--Testcase 001:
+CREATE EXTENSION bytea_exif;
+--Testcase 002:
+CREATE TABLE photo (id int8 PRIMARY KEY, img bytea);
+--Testcase 003:
+\copy photo from './sql/test_images.data';
+--Testcase 004:
+CREATE FUNCTION wait_sidecar(n int) RETURNS void AS $$
+BEGIN
+  FOR i IN 1..600 LOOP
+    EXIT WHEN (SELECT count(*) FROM bytea_exif_sidecar) >= n;
+    PERFORM pg_sleep(0.1);
+  END LOOP;
+END $$ LANGUAGE plpgsql;
+
+--Testcase 010:
+INSERT INTO bytea_exif_queue (relid, attname, pk) SELECT 'photo', 'img', id::text FROM photo;
+--Testcase 011:
+SELECT wait_sidecar(9) IS NULL w;
+--Testcase 012:
+SELECT relid, pk, exif IS NOT NULL exif,
+       to_char(datetime_original AT TIME ZONE 'UTC', 'YYYY-MM-DD HH24:MI:SS') dto, point
+FROM bytea_exif_sidecar ORDER BY pk::int;
+--Testcase 013:
+SELECT count(*) FROM bytea_exif_queue;
+
+-- missing queue table: the worker logs it and sleeps, it is not restarted
+--Testcase 020:
+CREATE TABLE worker_pid AS SELECT pid FROM pg_stat_activity WHERE backend_type IN ('bytea_exif worker', 'background worker') AND datname = current_database();
+--Testcase 021:
+SELECT count(*) FROM worker_pid;
+--Testcase 022:
+ALTER SYSTEM SET bytea_exif.worker_queue_table = 'no_such_queue';
+--Testcase 023:
+SELECT pg_reload_conf() r, pg_sleep(3) IS NULL s;
+--Testcase 024:
+SELECT count(*) FROM pg_stat_activity JOIN worker_pid USING (pid);
+
+-- quoted mixed case queue table name
+--Testcase 030:
+CREATE TABLE "Photo Queue" (LIKE bytea_exif_queue INCLUDING DEFAULTS);
+--Testcase 031:
+ALTER SYSTEM SET bytea_exif.worker_queue_table = '"Photo Queue"';
+--Testcase 032:
+SELECT pg_reload_conf() r;
+--Testcase 033:
+CREATE TABLE "Photo Set" (name text PRIMARY KEY, img bytea);
+--Testcase 034:
+INSERT INTO "Photo Set" SELECT 'photo ' || id, img FROM photo WHERE id IN (1, 5);
+--Testcase 035:
+INSERT INTO "Photo Queue" (relid, attname, pk) SELECT '"Photo Set"', 'img', name FROM "Photo Set";
+--Testcase 036:
+SELECT wait_sidecar(11) IS NULL w;
+--Testcase 037:
+SELECT relid, pk, exif IS NOT NULL exif, point FROM bytea_exif_sidecar WHERE relid = '"Photo Set"'::regclass ORDER BY pk;
+--Testcase 038:
+ALTER SYSTEM RESET bytea_exif.worker_queue_table;
+--Testcase 039:
+SELECT pg_reload_conf() r;
+
+-- one broken image or key value does not drop other entries of the batch
+--Testcase 040:
+CREATE TABLE photo_bad (id int8 PRIMARY KEY, img bytea);
+--Testcase 041:
+INSERT INTO photo_bad SELECT id, CASE WHEN id = 1 THEN overlay(overlay(img placing '\x01'::bytea from 140 for 1) placing '\xff'::bytea from 153 for 1) ELSE img END FROM photo WHERE id IN (1, 2, 4);
+--Testcase 042:
+INSERT INTO bytea_exif_queue (relid, attname, pk) SELECT 'photo_bad', 'img', pk FROM (VALUES ('1'), ('2'), ('x'), ('4')) v(pk);
+--Testcase 043:
+SELECT wait_sidecar(15) IS NULL w;
+--Testcase 044:
+SELECT pk, exif -> 'Make' make, exif ? 'Model' model, error IS NOT NULL error FROM bytea_exif_sidecar WHERE relid = 'photo_bad'::regclass ORDER BY pk;
+
+--Testcase 200:
+DROP EXTENSION bytea_exif CASCADE;